@@ -6,10 +6,10 @@
 #include <cstdint>
 #include <regex>
 
-Action::Action(Node* parent): Node("Action", parent) {}
-Action::Action(const std::string& code, Node* parent): Node("Action", parent), code(code) {}
+Action::Action(NodeKind kind, const std::string& code, Node* parent): Node(kind, parent), code(code) {}
+Action::Action(const std::string& code, Node* parent): Node(NK_ACTION, parent), code(code) {}
 Action::Action(const Action& action, Node* parent): Action(action.code, parent) {}
-Action::Action(Parser& p, Node* parent): Node("Action", parent) {
+Action::Action(Parser& p, Node* parent): Node(NK_ACTION, parent) {
     parse(p);
 }
 
@@ -59,7 +59,7 @@ bool Action::is_multiline() const {
     return code.find('\n') != std::string::npos || code.substr(0, 1) == "#";
 }
 
-size_t Action::hash() const {
+size_t Action::compute_hash() const {
     return std::hash<std::string> {}(code);
 }
 
@@ -91,7 +91,7 @@ void Action::renumber_capture(int from, int to) {
         if (p.match_re(f, false)) {
             result += t + p.last_re_match.str(1);
         } else if (p.match_string(false)) {
-            result += "\"" + to_c_string(p.last_match) + "\"";
+            result += "\"" + to_c_string(std::string(p.last_match)) + "\"";
         } else if (p.match_block_comment(false) || p.match_line_comment(false)) {
             result += p.last_match;
         } else if (p.match_any_char()) {
@@ -99,6 +99,7 @@ void Action::renumber_capture(int from, int to) {
         }
     }
     code = result;
+    modified();
 }
 
 bool operator==(const Action& a, const Action& b) {
@@ -5,9 +5,11 @@
 class Action: public Node {
 protected:
     std::string code;
-    Action(Node* parent);
+    Action(NodeKind kind, const std::string& code, Node* parent);
 
 public:
+    static const NodeKind KIND = NK_ACTION;
+
     Action(const std::string& code, Node* parent);
     Action(const Action& action, Node* parent);
     Action(Parser& p, Node* parent);
@@ -17,7 +19,7 @@ public:
     virtual std::string to_string(std::string indent = "") const override;
     virtual std::string dump(std::string = "") const override;
     virtual bool is_multiline() const override;
-    virtual size_t hash() const override;
+    virtual size_t compute_hash() const override;
 
     bool is_empty() const;
     bool contains_reference(const Reference& ref) const;
@@ -6,11 +6,11 @@
 #include "utils.h"
 
 Alternation::Alternation(const std::vector<Sequence>& sequences, Node* parent):
-    Node("Alternation", parent), sequences(sequences) {}
-Alternation::Alternation(Parser& p, Node* parent): Node("Alternation", parent) {
+    Node(NK_ALTERNATION, parent), sequences(sequences) {}
+Alternation::Alternation(Parser& p, Node* parent): Node(NK_ALTERNATION, parent) {
     parse(p);
 }
-Alternation::Alternation(Node* parent): Node("Alternation", parent) {}
+Alternation::Alternation(Node* parent): Node(NK_ALTERNATION, parent) {}
 
 void Alternation::parse(Parser& p) {
     debug("Parsing Alternation");
@@ -59,11 +59,11 @@ std::string Alternation::dump(std::string indent) const {
 }
 
 bool Alternation::is_multiline() const {
-    return sequences.size() > Config::get<int>("wrap-limit")
+    return sequences.size() > Config::settings().wrap_limit
         || std::any_of(sequences.begin(), sequences.end(), ::is_multiline);
 }
 
-size_t Alternation::hash() const {
+size_t Alternation::compute_hash() const {
     size_t hash = 0;
     for (const Sequence& s: sequences) {
         hash = combine(hash, s.hash());
@@ -96,17 +96,23 @@ const Sequence& Alternation::get_first_sequence() const {
 }
 
 void Alternation::insert(int index, const Alternation& a) {
-    sequences.insert(sequences.begin() + index, a.sequences.begin(), a.sequences.end());
+    sequences.insert(index, a.sequences);
+    for (int i = index; i < index + a.size(); i++) {
+        adopt(sequences[i]);
+    }
+    modified();
 }
 
 void Alternation::erase(int index) {
-    sequences.erase(sequences.begin() + index);
+    sequences.erase(index);
+    modified();
 }
 
 void Alternation::erase(Sequence* s) {
     for (int i = 0; i < sequences.size(); i++) {
         if (*s == sequences[i]) {
-            sequences.erase(sequences.begin() + i);
+            sequences.erase(i);
+            modified();
             return;
         }
     }
@@ -1,11 +1,14 @@
 #pragma once
 #include "ast/node.h"
+#include "ast/node_list.h"
 #include "ast/sequence.h"
 
 class Alternation: public Node {
-    std::vector<Sequence> sequences;
+    NodeList<Sequence> sequences;
 
 public:
+    static const NodeKind KIND = NK_ALTERNATION;
+
     Alternation(const std::vector<Sequence>& sequences, Node* parent);
     Alternation(Parser& p, Node* parent);
     Alternation(Node* parent);
@@ -14,7 +17,7 @@ public:
     virtual std::string to_string(std::string indent = "") const override;
     virtual std::string dump(std::string indent = "") const override;
     virtual bool is_multiline() const override;
-    virtual size_t hash() const override;
+    virtual size_t compute_hash() const override;
 
     Sequence& get(int index);
     virtual Node* operator[](int index) override;
@@ -28,6 +31,7 @@ public:
     void erase(Sequence* s);
 
     friend bool operator==(const Alternation& a, const Alternation& b);
+    template<class F> friend bool for_each_child(Node& node, F&& fn);
 };
 
 bool operator==(const Alternation& a, const Alternation& b);
@@ -0,0 +1,151 @@
+#include "ast/arena.h"
+
+#include <algorithm>
+#include <tuple>
+
+thread_local Arena::Scope* Arena::active = nullptr;
+
+Arena::Pool::Pool(): next(nullptr), available(0), allocations(0), reused(0) {}
+
+void* Arena::Pool::reuse(size_t slot) {
+    allocations++;
+    if (slot < free_lists.size() && free_lists[slot]) {
+        void* ptr = free_lists[slot];
+        free_lists[slot] = *(void**)ptr;
+        reused++;
+        return ptr;
+    }
+    return nullptr;
+}
+
+void Arena::Pool::release(void* ptr, size_t slot) {
+    if (slot >= free_lists.size()) {
+        free_lists.resize(slot + 1, nullptr);
+    }
+    *(void**)ptr = free_lists[slot];
+    free_lists[slot] = ptr;
+}
+
+void* Arena::Pool::carve(size_t size) {
+    void* ptr = next;
+    next += size;
+    available -= size;
+    return ptr;
+}
+
+Arena::Scope::Scope(Arena* arena): arena(arena), previous(active) {
+    active = this;
+}
+
+Arena::Scope::~Scope() {
+    active = previous;
+    if (!arena) {
+        return;
+    }
+    // everything released in this scope goes back to the arena, so that other scopes can reuse it
+    std::lock_guard<std::mutex> guard(arena->lock);
+    Pool& shared = arena->shared;
+    for (size_t slot = 0; slot < pool.free_lists.size(); slot++) {
+        void* head = pool.free_lists[slot];
+        if (!head) {
+            continue;
+        }
+        void* tail = head;
+        while (*(void**)tail) {
+            tail = *(void**)tail;
+        }
+        if (slot >= shared.free_lists.size()) {
+            shared.free_lists.resize(slot + 1, nullptr);
+        }
+        *(void**)tail = shared.free_lists[slot];
+        shared.free_lists[slot] = head;
+    }
+    if (pool.available > 0) {
+        arena->spare.emplace_back(pool.next, pool.available);
+    }
+    shared.allocations += pool.allocations;
+    shared.reused += pool.reused;
+}
+
+Arena::Arena() {}
+
+Arena* Arena::current() {
+    if (active && active->arena) {
+        return active->arena;
+    }
+    // intentionally leaked, nodes without a grammar might be released during static destruction
+    static Arena* global = new Arena();
+    return global;
+}
+
+// Gives the pool at least size bytes of contiguous memory, must be called with the lock held. The shared
+// pool gets a new block, private pools of the scopes get a chunk of it or a rest left by some finished scope.
+void Arena::refill(Pool& pool, size_t size) {
+    if (&pool == &shared) {
+        if (size > shared.available) {
+            size_t block_size = std::max(BLOCK_SIZE, size);
+            blocks.emplace_back(new char[block_size]);
+            shared.next = blocks.back().get();
+            shared.available = block_size;
+        }
+        return;
+    }
+    while (!spare.empty() && spare.back().second < size) {
+        spare.pop_back();
+    }
+    if (!spare.empty()) {
+        std::tie(pool.next, pool.available) = spare.back();
+        spare.pop_back();
+        return;
+    }
+    size_t chunk_size = std::max(CHUNK_SIZE, size);
+    refill(shared, chunk_size);
+    pool.next = (char*)shared.carve(chunk_size);
+    pool.available = chunk_size;
+}
+
+void* Arena::allocate(size_t size) {
+    size_t slot = (size + ALIGNMENT - 1) / ALIGNMENT;
+    size = slot * ALIGNMENT;
+    if (active && active->arena == this) {
+        Pool& pool = active->pool;
+        void* ptr = pool.reuse(slot);
+        if (ptr) {
+            return ptr;
+        }
+        if (size > pool.available) {
+            std::lock_guard<std::mutex> guard(lock);
+            refill(pool, size);
+        }
+        return pool.carve(size);
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    void* ptr = shared.reuse(slot);
+    if (ptr) {
+        return ptr;
+    }
+    refill(shared, size);
+    return shared.carve(size);
+}
+
+void Arena::deallocate(void* ptr, size_t size) {
+    size_t slot = (size + ALIGNMENT - 1) / ALIGNMENT;
+    if (active && active->arena == this) {
+        active->pool.release(ptr, slot);
+        return;
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    shared.release(ptr, slot);
+}
+
+long Arena::get_allocations() const {
+    return shared.allocations;
+}
+
+long Arena::get_reused() const {
+    return shared.reused;
+}
+
+long Arena::get_blocks() const {
+    return blocks.size();
+}
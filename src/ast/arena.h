@@ -0,0 +1,140 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Pool allocator for AST nodes. Memory is obtained from the system in large blocks and
+// released nodes are kept in per-size free lists, so that building and rewriting a grammar
+// needs only a handful of real allocations. Each Grammar owns its own arena and activates
+// it (see Scope) while it is being parsed or optimized. The arena can be shared by multiple
+// threads, each of them has to activate it separately.
+class Arena {
+    static constexpr size_t BLOCK_SIZE = 256 * 1024;
+    static constexpr size_t CHUNK_SIZE = 16 * 1024;
+    static constexpr size_t ALIGNMENT = alignof(std::max_align_t);
+
+    // Memory available for allocation: free lists and the rest of the current chunk.
+    struct Pool {
+        char* next;
+        size_t available;
+        std::vector<void*> free_lists;
+        long allocations;
+        long reused;
+
+        Pool();
+        void* reuse(size_t slot);
+        void release(void* ptr, size_t slot);
+        void* carve(size_t size);
+    };
+
+    std::vector<std::unique_ptr<char[]>> blocks;
+    Pool shared;
+    std::vector<std::pair<char*, size_t>> spare; // unused rests of the chunks of finished scopes
+    std::mutex lock;                             // guards all of the above
+
+    void refill(Pool& pool, size_t size);
+
+public:
+    // Makes the arena current for the lifetime of the scope object. Nodes are allocated from and
+    // released to the private pool of the scope, which takes memory from the arena in chunks, so
+    // threads optimizing rules of the same grammar in parallel do not wait for each other.
+    class Scope {
+        Arena* arena;
+        Scope* previous;
+        Pool pool;
+
+        friend class Arena;
+
+    public:
+        Scope(Arena* arena);
+        ~Scope();
+    };
+
+private:
+    static thread_local Scope* active;
+
+public:
+
+    Arena();
+    Arena(const Arena& other) = delete;
+    Arena& operator=(const Arena& other) = delete;
+
+    // Returns the active arena, or the global one if no grammar is being processed.
+    static Arena* current();
+
+    void* allocate(size_t size);
+    void deallocate(void* ptr, size_t size);
+
+    template<class T, class... Args> T* create(Args&&... args);
+    template<class T> void destroy(T* ptr);
+
+    long get_allocations() const;
+    long get_reused() const;
+    long get_blocks() const;
+};
+
+template<class T, class... Args> T* Arena::create(Args&&... args) {
+    void* ptr = allocate(sizeof(T));
+    try {
+        return new (ptr) T(std::forward<Args>(args)...);
+    } catch (...) {
+        deallocate(ptr, sizeof(T));
+        throw;
+    }
+}
+
+template<class T> void Arena::destroy(T* ptr) {
+    ptr->~T();
+    deallocate(ptr, sizeof(T));
+}
+
+// Owning handle to a single node allocated in an arena. To make deep copies visible
+// in the code, the handle can not be copied implicitly, use clone() instead.
+template<class T> class NodePtr {
+    Arena* arena;
+    T* ptr;
+
+    NodePtr(Arena* arena, T* ptr): arena(arena), ptr(ptr) {}
+
+public:
+    NodePtr(): arena(nullptr), ptr(nullptr) {}
+    NodePtr(const NodePtr& other) = delete;
+    NodePtr(NodePtr&& other) noexcept: arena(other.arena), ptr(other.ptr) {
+        other.ptr = nullptr;
+    }
+    NodePtr& operator=(const NodePtr& other) = delete;
+    NodePtr& operator=(NodePtr&& other) noexcept {
+        std::swap(arena, other.arena);
+        std::swap(ptr, other.ptr);
+        return *this;
+    }
+    ~NodePtr() {
+        if (ptr) {
+            arena->destroy(ptr);
+        }
+    }
+
+    template<class... Args> static NodePtr make(Args&&... args) {
+        Arena* arena = Arena::current();
+        return NodePtr(arena, arena->create<T>(std::forward<Args>(args)...));
+    }
+
+    NodePtr clone() const {
+        return ptr ? make(*ptr) : NodePtr();
+    }
+
+    T* get() const {
+        return ptr;
+    }
+    T& operator*() const {
+        return *ptr;
+    }
+    T* operator->() const {
+        return ptr;
+    }
+    explicit operator bool() const {
+        return ptr != nullptr;
+    }
+};
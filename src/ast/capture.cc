@@ -5,11 +5,23 @@
 #include "utils.h"
 
 Capture::Capture(const Alternation& expression, Node* parent):
-    Node("Capture", parent), expression(new Alternation(expression)), num(-1) {}
-Capture::Capture(Parser& p, Node* parent): Node("Capture", parent) {
+    Node(NK_CAPTURE, parent), expression(NodePtr<Alternation>::make(expression)), num(-1) {}
+Capture::Capture(Parser& p, Node* parent): Node(NK_CAPTURE, parent) {
     parse(p);
 }
 
+Capture::Capture(const Capture& other): Node(other), expression(other.expression.clone()), num(other.num) {}
+
+Capture::~Capture() {}
+
+Capture& Capture::operator=(const Capture& other) {
+    NodePtr<Alternation> copy = other.expression.clone();
+    Node::operator=(other);
+    expression = std::move(copy);
+    num = other.num;
+    return *this;
+}
+
 void Capture::parse(Parser& p) {
     debug("Parsing Capture");
     DebugIndent _;
@@ -19,7 +31,7 @@ void Capture::parse(Parser& p) {
         s.rollback();
         return;
     }
-    expression.reset(new Alternation(p, this));
+    expression = NodePtr<Alternation>::make(p, this);
     if (!*expression) {
         s.rollback();
         return;
@@ -65,7 +77,7 @@ Node* Capture::operator[](int index) {
 
 const size_t CAPTURE_HASH = std::hash<const char*> {}("capture");
 
-size_t Capture::hash() const {
+size_t Capture::compute_hash() const {
     return combine(CAPTURE_HASH, expression->hash());
 }
 
@@ -1,4 +1,5 @@
 #pragma once
+#include "ast/arena.h"
 #include "ast/node.h"
 
 class Alternation;
@@ -6,18 +7,23 @@ class Rule;
 class Group;
 
 class Capture: public Node {
-    std::shared_ptr<Alternation> expression;
+    NodePtr<Alternation> expression;
     int num;
 
 public:
+    static const NodeKind KIND = NK_CAPTURE;
+
     Capture(const Alternation& expression, Node* parent);
     Capture(Parser& p, Node* parent);
+    Capture(const Capture& other);
+    Capture& operator=(const Capture& other);
+    virtual ~Capture();
 
     virtual void parse(Parser& p) override;
     virtual std::string to_string(std::string indent = "") const override;
     virtual std::string dump(std::string = "") const override;
     virtual bool is_multiline() const override;
-    virtual size_t hash() const override;
+    virtual size_t compute_hash() const override;
 
     virtual Node* operator[](int index) override;
     virtual long size() const override;
@@ -27,6 +33,7 @@ public:
     Group convert_to_group();
 
     friend bool operator==(const Capture& a, const Capture& b);
+    template<class F> friend bool for_each_child(Node& node, F&& fn);
     friend class Rule;
 };
 
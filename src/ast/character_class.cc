@@ -10,11 +10,12 @@
 #include <sstream>
 
 CharacterClass::CharacterClass(const std::string& content, Node* parent):
-    Node("CharacterClass", parent), content(content), dash(false), negation(false) {
+    Node(NK_CHARACTER_CLASS, parent), content(content), dash(false), negation(false) {
     Parser p(content);
     parse(p);
 }
-CharacterClass::CharacterClass(Parser& p, Node* parent): Node("CharacterClass", parent), dash(false), negation(false) {
+CharacterClass::CharacterClass(Parser& p, Node* parent):
+    Node(NK_CHARACTER_CLASS, parent), dash(false), negation(false) {
     parse(p);
 }
 
@@ -147,7 +148,7 @@ bool CharacterClass::is_multiline() const {
     return false;
 }
 
-size_t CharacterClass::hash() const {
+size_t CharacterClass::compute_hash() const {
     return combine(dash + 2 * negation, content);
 }
 
@@ -168,11 +169,16 @@ bool CharacterClass::normalize() {
         return acc;
     });
     update_content();
-    return content != original;
+    if (content == original) {
+        return false;
+    }
+    modified();
+    return true;
 }
 
 void CharacterClass::flip_negation() {
     negation = !negation;
+    modified();
 }
 
 bool CharacterClass::any_char() const {
@@ -201,6 +207,7 @@ void CharacterClass::merge(const CharacterClass& cc) {
     content += cc.content;
     tokenize();
     update_content();
+    modified();
 }
 
 bool operator==(const CharacterClass& a, const CharacterClass& b) {
@@ -17,6 +17,8 @@ class CharacterClass: public Node {
     void update_content();
 
 public:
+    static const NodeKind KIND = NK_CHARACTER_CLASS;
+
     CharacterClass(const std::string& content, Node* parent);
     CharacterClass(Parser& p, Node* parent);
 
@@ -35,7 +37,7 @@ public:
     virtual std::string to_string(std::string indent = "") const override;
     virtual std::string dump(std::string = "") const override;
     virtual bool is_multiline() const override;
-    virtual size_t hash() const override;
+    virtual size_t compute_hash() const override;
 
     friend bool operator==(const CharacterClass& a, const CharacterClass& b);
 };
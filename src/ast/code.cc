@@ -4,8 +4,8 @@
 #include "log.h"
 #include "utils.h"
 
-Code::Code(const std::string& content, Node* parent): Node("Code", parent), content(content) {}
-Code::Code(Parser& p, Node* parent): Node("Code", parent) {
+Code::Code(const std::string& content, Node* parent): Node(NK_CODE, parent), content(content) {}
+Code::Code(Parser& p, Node* parent): Node(NK_CODE, parent) {
     parse(p);
 }
 
@@ -47,10 +47,17 @@ bool Code::is_multiline() const {
     return true;
 }
 
-size_t Code::hash() const {
+size_t Code::compute_hash() const {
     return std::hash<std::string> {}(content);
 }
 
 bool Code::empty() const {
     return comments.empty() && content.empty();
 }
+
+void Code::append(const Code& other) {
+    comments.insert(comments.end(), other.comments.begin(), other.comments.end());
+    if (!other.content.empty()) {
+        content = other.content;
+    }
+}
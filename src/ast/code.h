@@ -5,6 +5,8 @@ class Code: public Node {
     std::string content;
 
 public:
+    static const NodeKind KIND = NK_CODE;
+
     Code(const std::string& content, Node* parent);
     Code(Parser& p, Node* parent);
 
@@ -12,7 +14,9 @@ public:
     virtual std::string to_string(std::string indent = "") const override;
     virtual std::string dump(std::string indent = "") const override;
     virtual bool is_multiline() const override;
-    virtual size_t hash() const override;
+    virtual size_t compute_hash() const override;
 
     bool empty() const;
+    // Adds comments of the other code block, its content replaces this one unless it is empty.
+    void append(const Code& other);
 };
@@ -6,8 +6,8 @@
 Directive::Directive(
     const std::string& name, const std::string& value, const std::string& version, Directive::Type type, Node* parent
 ):
-    Node("Directive", parent), name(name), value(value), version(version), type(type) {}
-Directive::Directive(Parser& p, Node* parent): Node("Directive", parent) {
+    Node(NK_DIRECTIVE, parent), name(name), value(value), version(version), type(type) {}
+Directive::Directive(Parser& p, Node* parent): Node(NK_DIRECTIVE, parent) {
     parse(p);
 }
 
@@ -148,6 +148,6 @@ bool Directive::is_multiline() const {
     return !comments.empty() || type == CODE;
 }
 
-size_t Directive::hash() const {
+size_t Directive::compute_hash() const {
     return combine(std::hash<std::string> {}(name), std::hash<std::string> {}(value));
 }
@@ -9,6 +9,8 @@ class Directive: public Node {
     Type type;
 
 public:
+    static const NodeKind KIND = NK_DIRECTIVE;
+
     Directive(const std::string& name, const std::string& value, const std::string& version, Type type, Node* parent);
     Directive(Parser& p, Node* parent);
 
@@ -20,5 +22,5 @@ public:
     virtual std::string to_string(std::string indent = "") const override;
     virtual std::string dump(std::string indent = "") const override;
     virtual bool is_multiline() const override;
-    virtual size_t hash() const override;
+    virtual size_t compute_hash() const override;
 };
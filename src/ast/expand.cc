@@ -2,8 +2,8 @@
 
 #include "log.h"
 
-Expand::Expand(int content, Node* parent): Node("Expand", parent), content(content) {}
-Expand::Expand(Parser& p, Node* parent): Node("Expand", parent) {
+Expand::Expand(int content, Node* parent): Node(NK_EXPAND, parent), content(content) {}
+Expand::Expand(Parser& p, Node* parent): Node(NK_EXPAND, parent) {
     parse(p);
 }
 
@@ -16,7 +16,7 @@ void Expand::parse(Parser& p) {
         s.rollback();
         return;
     } else if (p.match_number()) {
-        content = std::stoi(p.last_match);
+        content = std::stoi(std::string(p.last_match));
     } else {
         error(PARSING_ERROR, "expected number!");
     }
@@ -36,12 +36,13 @@ bool Expand::is_multiline() const {
     return false;
 }
 
-size_t Expand::hash() const {
+size_t Expand::compute_hash() const {
     return std::hash<int> {}(content);
 }
 
 void Expand::shift(int n) {
     content += n;
+    modified();
 }
 
 bool operator==(const Expand& a, const Expand& b) {
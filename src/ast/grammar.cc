@@ -1,30 +1,53 @@
 #include "ast/grammar.h"
 
+#include "ast/visitor.h"
+#include "cache.h"
 #include "log.h"
+#include "thread_pool.h"
 #include "utils.h"
 
+#include <algorithm>
+#include <exception>
+#include <optional>
 #include <set>
+#include <sys/stat.h>
 
 Grammar::Grammar(const std::vector<TopLevel>& nodes, const Code& code, const std::string& input_file):
-    Node("Grammar", nullptr), nodes(nodes), code(code), input_file(input_file), importLevel(0) {}
+    Node(NK_GRAMMAR, nullptr), arena(new Arena()), code(code), input_file(input_file), importLevel(0) {
+    Arena::Scope scope(arena.get());
+    this->nodes = NodeList<TopLevel>(nodes);
+}
 
 Grammar::Grammar(Parser& p, const std::string& input_file):
-    Node("Grammar", nullptr), code("", this), input_file(input_file), importLevel(0) {
+    Node(NK_GRAMMAR, nullptr), arena(new Arena()), code("", this), input_file(input_file), importLevel(0) {
+    parse(p);
+}
+
+Grammar::Grammar(Parser& p, const std::string& input_file, int importLevel):
+    Node(NK_GRAMMAR, nullptr), arena(new Arena()), code("", this), input_file(input_file), importLevel(importLevel) {
     parse(p);
 }
 
 Grammar::Grammar(const std::string& s, const std::string& input_file):
-    Node("Grammar", nullptr), code("", this), input_file(input_file), importLevel(0) {
+    Node(NK_GRAMMAR, nullptr), arena(new Arena()), code("", this), input_file(input_file), importLevel(0) {
     Parser p(s);
     parse(p);
 }
 
+Grammar::Grammar(const Grammar& other):
+    Node(other), arena(other.arena), code(other.code), input_file(other.input_file), importLevel(other.importLevel) {
+    Arena::Scope scope(arena.get());
+    nodes = other.nodes;
+    update_parents();
+}
+
 void Grammar::parse(Parser& p) {
     debug("Parsing Grammar");
     DebugIndent _;
+    Arena::Scope scope(arena.get());
     debug("Parsing comments for node of type Grammar");
     while (p.match_comment()) {
-        comments.push_back(p.last_match);
+        comments.emplace_back(p.last_match);
         debug("Comment: '%s'", comments.back().c_str());
     }
 
@@ -36,20 +59,7 @@ void Grammar::parse(Parser& p) {
         }
         Directive d(p, this);
         if (d) {
-            if (d.is_import() && !Config::get<bool>("no-follow") && Config::get(O_ALL)) {
-                std::string name = d.get_value();
-                std::string path =
-                    name.substr(0, 1) != "/" ? find_file(name, Config::get_all_imports_dirs(input_file)) : name;
-                if (path.empty()) {
-                    error(IO_ERROR, "File '%s' not found", d.get_value().c_str());
-                }
-                importLevel++;
-                log(1, "Importing file '%s' (import level = %d)...", path.c_str(), importLevel);
-                Parser parser(read_file(path));
-                parse(parser);
-                importLevel--;
-                log(3, "Import done, returning to previous file (import level = %d).", importLevel);
-            } else if (importLevel > 0 && d.is_version()) {
+            if (importLevel > 0 && d.is_version()) {
                 log(4, "Skipping %version from imported file.");
             } else {
                 nodes.push_back(d);
@@ -63,10 +73,196 @@ void Grammar::parse(Parser& p) {
         debug("Grammar parsed so far:\n%s", dump().c_str());
         error(PARSING_ERROR, "Failed to parse grammar!");
     }
+    if (importLevel == 0 && !Config::settings().no_follow && Config::get(O_ALL)) {
+        load_imports();
+    }
     update_parents();
     valid = true;
 }
 
+std::string Grammar::find_import(const Directive& d, const std::vector<std::string>& dirs) {
+    std::string name = d.get_value();
+    std::string path = name.substr(0, 1) != "/" ? find_file(name, dirs) : name;
+    if (path.empty()) {
+        error(IO_ERROR, "File '%s' not found", name.c_str());
+    }
+    return canonical_path(path);
+}
+
+// Imported files parsed so far, kept only in server and watch modes, where the same files are imported again
+// and again. Parsed file is reused until it changes on disk, least recently used files are dropped when there
+// are more than IMPORT_CACHE_SIZE of them.
+struct CachedImport {
+    std::shared_ptr<const Grammar> grammar;
+    struct timespec mtime;
+    off_t size;
+    unsigned long last_used;
+};
+static const size_t IMPORT_CACHE_SIZE = 64;
+static std::mutex import_cache_lock;
+static std::map<std::string, CachedImport> import_cache;
+static unsigned long import_cache_clock = 0;
+
+std::shared_ptr<const Grammar> Grammar::load_import(const std::string& path) {
+    struct stat st;
+    bool cached = (Config::settings().serve || Config::settings().watch) && stat(path.c_str(), &st) == 0;
+    if (cached) {
+        std::lock_guard<std::mutex> guard(import_cache_lock);
+        auto it = import_cache.find(path);
+        if (it != import_cache.end() && it->second.size == st.st_size &&
+            it->second.mtime.tv_sec == st.st_mtim.tv_sec && it->second.mtime.tv_nsec == st.st_mtim.tv_nsec) {
+            log(2, "Using already parsed imported file '%s'...", path.c_str());
+            it->second.last_used = ++import_cache_clock;
+            return it->second.grammar;
+        }
+    }
+    log(2, "Loading imported file '%s'...", path.c_str());
+    FileContent content(path);
+    Parser parser(content.view());
+    std::shared_ptr<const Grammar> result(new Grammar(parser, path, 1));
+    if (cached) {
+        std::lock_guard<std::mutex> guard(import_cache_lock);
+        import_cache[path] = {result, st.st_mtim, st.st_size, ++import_cache_clock};
+        if (import_cache.size() > IMPORT_CACHE_SIZE) {
+            auto oldest = std::min_element(import_cache.begin(), import_cache.end(), [](const auto& a, const auto& b) {
+                return a.second.last_used < b.second.last_used;
+            });
+            log(3, "Dropping parsed imported file '%s' from cache", oldest->first.c_str());
+            import_cache.erase(oldest);
+        }
+    }
+    return result;
+}
+
+std::set<std::string> Grammar::find_imported_files(const std::string& input_file) {
+    std::vector<std::string> dirs = Config::get_all_imports_dirs(input_file);
+    std::set<std::string> result;
+    std::vector<std::string> pending = {canonical_path(input_file)};
+    while (!pending.empty()) {
+        std::shared_ptr<const Grammar> file = load_import(pending.back());
+        pending.pop_back();
+        for (const TopLevel& node: file->nodes) {
+            const Directive* d = std::get_if<Directive>(&node);
+            if (d && d->is_import()) {
+                std::string path = find_import(*d, dirs);
+                if (result.insert(path).second) {
+                    pending.push_back(path);
+                }
+            }
+        }
+    }
+    return result;
+}
+
+static thread_local ImportCapture* import_capture = nullptr;
+
+ImportCapture::ImportCapture(std::optional<std::set<std::string>>& files): previous(import_capture), files(files) {
+    import_capture = this;
+}
+
+ImportCapture::~ImportCapture() {
+    import_capture = previous;
+}
+
+void Grammar::load_imports() {
+    // Imported files are discovered level by level and all files on the same level are read and parsed
+    // in parallel, each into a separate grammar. Files imported from multiple places are only loaded once.
+    std::vector<std::string> dirs = Config::get_all_imports_dirs(input_file);
+    ImportedFiles files;
+    if (import_capture && !import_capture->files) {
+        import_capture->files.emplace();
+    }
+    std::vector<const Grammar*> pending = {this};
+    ThreadPool pool(Config::settings().jobs);
+    while (!pending.empty()) {
+        std::vector<std::string> paths;
+        for (const Grammar* g: pending) {
+            for (const TopLevel& node: g->nodes) {
+                const Directive* d = std::get_if<Directive>(&node);
+                if (d && d->is_import()) {
+                    std::string path = find_import(*d, dirs);
+                    if (!files.count(path) && std::find(paths.begin(), paths.end(), path) == paths.end()) {
+                        paths.push_back(path);
+                        if (import_capture) {
+                            import_capture->files->insert(path);
+                        }
+                    }
+                }
+            }
+        }
+
+        std::vector<std::shared_ptr<const Grammar>> loaded(paths.size());
+        std::vector<std::string> logs(paths.size());
+        std::vector<std::exception_ptr> failures(paths.size());
+        bool parallel = pool.size() > 1 && paths.size() > 1;
+        pool.run(paths.size(), [&](int i) {
+            std::optional<LogCapture> capture;
+            if (parallel) {
+                capture.emplace(logs[i]);
+            }
+            try {
+                loaded[i] = load_import(paths[i]);
+            } catch (...) {
+                if (!parallel) {
+                    throw;
+                }
+                failures[i] = std::current_exception();
+            }
+        });
+
+        pending.clear();
+        for (int i = 0; i < paths.size(); i++) {
+            LogCapture::replay(logs[i]);
+            if (failures[i]) {
+                std::rethrow_exception(failures[i]);
+            }
+            pending.push_back(loaded[i].get());
+            files[paths[i]] = std::move(loaded[i]);
+        }
+    }
+
+    // Contents of the imported files replace the %import directives, in the same order as if they were parsed
+    // one after another. Trailing comments and code of imported files go before those of the main file.
+    std::set<std::string> done;
+    NodeList<TopLevel> result;
+    Code imported_code("", this);
+    splice_imports(*this, 0, files, dirs, done, result, imported_code);
+    imported_code.append(code);
+    nodes = std::move(result);
+    code = imported_code;
+}
+
+void Grammar::splice_imports(
+    const Grammar& file,
+    int level,
+    ImportedFiles& files,
+    const std::vector<std::string>& dirs,
+    std::set<std::string>& done,
+    NodeList<TopLevel>& result,
+    Code& imported_code
+) {
+    for (const TopLevel& node: file.nodes) {
+        const Directive* d = std::get_if<Directive>(&node);
+        if (!d || !d->is_import()) {
+            result.push_back(node);
+            continue;
+        }
+        std::string path = find_import(*d, dirs);
+        if (!done.insert(path).second) {
+            log(2, "Skipping file '%s', it was already imported.", path.c_str());
+            continue;
+        }
+        const Grammar& imported = *files[path];
+        log(1, "Importing file '%s' (import level = %d)...", path.c_str(), level + 1);
+        comments.insert(comments.end(), imported.comments.begin(), imported.comments.end());
+        splice_imports(imported, level + 1, files, dirs, done, result, imported_code);
+        imported_code.append(imported.code);
+        // each file is spliced only once, so it is not needed here anymore (but it may still be cached)
+        files[path].reset();
+        log(3, "Import done, returning to previous file (import level = %d).", level);
+    }
+}
+
 std::string join(const std::vector<std::string>& parts, const char* delimiter) {
     std::string result;
     for (int i = 0; i < parts.size(); i++) {
@@ -110,6 +306,89 @@ std::string Grammar::to_string(std::string indent) const {
     return result;
 }
 
+// Checks that a rule ending at given position in the content would really end there if it was parsed, i.e. that
+// it is followed by whitespace and then by another rule, directive, code block or end of the input. Anything else
+// could continue the rule (e.g. a quantifier, an alternative or another term), including a comment on the same
+// line, which would be parsed as a post-comment of the last term.
+static bool is_rule_end(std::string_view content, size_t end) {
+    if (end < content.size() && !isspace(content[end]) && content[end - 1] != '\n') {
+        return false;
+    }
+    Parser p(content);
+    p.skip(end);
+    if (p.peek_re("[ \t]*#", false)) {
+        return false;
+    }
+    p.skip_space();
+    while (p.match_comment()) {
+        p.skip_space();
+    }
+    return p.is_eof() || p.peek('%') || p.peek_re("[A-Za-z_]\\S*\\s*<-", false);
+}
+
+std::string Grammar::format(std::string_view content, const std::string& input_file, FormatCache& cache) {
+    // mirrors parse() and to_string(), except that rules are formatted one by one as soon as they are parsed
+    Grammar g(std::vector<TopLevel>(), Code("", nullptr), input_file);
+    Arena::Scope scope(g.arena.get());
+    Parser p(content);
+    while (p.match_comment()) {
+        g.comments.emplace_back(p.last_match);
+    }
+    std::vector<std::string> parts;
+    std::string comments = g.format_comments();
+    if (comments.size()) {
+        parts.push_back(comments);
+    }
+
+    int reused = 0;
+    int formatted = 0;
+    while (true) {
+        unsigned long start = p.get_pos();
+        const FormatCache::Entry* cached = nullptr;
+        for (const FormatCache::Entry* entry: cache.find(content.substr(start))) {
+            if (is_rule_end(content, start + entry->source.size())) {
+                cached = entry;
+                break;
+            }
+        }
+        if (cached) {
+            parts.push_back(cached->formatted);
+            cache.add(cached->source, cached->formatted);
+            p.skip(cached->source.size());
+            reused++;
+            continue;
+        }
+        Rule r(p, &g);
+        if (r) {
+            r.update_parents();
+            parts.push_back(r.to_string());
+            cache.add(content.substr(start, p.get_pos() - start), parts.back());
+            formatted++;
+            continue;
+        }
+        Directive d(p, &g);
+        if (d) {
+            parts.push_back(d.to_string());
+            continue;
+        }
+        g.code.parse(p);
+        if (g.code) {
+            break;
+        }
+        error(PARSING_ERROR, "Failed to parse grammar!");
+    }
+    log(2, "Formatted %d rules, %d unchanged rules were taken from cache", formatted, reused);
+
+    if (!g.code.empty()) {
+        parts.push_back(g.code.to_string());
+    }
+    std::string result = join(parts, "\n\n");
+    if (!result.empty() && result.back() != '\n') {
+        result += "\n";
+    }
+    return result;
+}
+
 std::string Grammar::dump(std::string indent) const {
     std::string result = indent + "GRAMMAR";
     if (!comments.empty()) {
@@ -129,7 +408,7 @@ bool Grammar::is_multiline() const {
     return true;
 }
 
-size_t Grammar::hash() const {
+size_t Grammar::compute_hash() const {
     return 0; // no need to compute hash of full grammar
 }
 
@@ -150,9 +429,56 @@ long Grammar::size() const {
 }
 
 void Grammar::erase(Rule* rule) {
-    std::vector<TopLevel>::iterator it =
-        std::find_if(nodes.begin(), nodes.end(), [rule](const TopLevel& n) { return std::get_if<Rule>(&n) == rule; });
-    nodes.erase(it);
+    for (int i = 0; i < nodes.size(); i++) {
+        if (std::get_if<Rule>(&nodes[i]) == rule) {
+            symbols.erase(*rule);
+            nodes.erase(i);
+            return;
+        }
+    }
+}
+
+Arena* Grammar::get_arena() const {
+    return arena.get();
+}
+
+const std::string& Grammar::get_input_file() const {
+    return input_file;
+}
+
+SymbolTable& Grammar::get_symbols() {
+    if (!symbols.is_built()) {
+        symbols.build(get_rules());
+    }
+    return symbols;
+}
+
+std::vector<Rule*> Grammar::get_rules() {
+    std::vector<Rule*> result;
+    for (TopLevel& node: nodes) {
+        if (std::holds_alternative<Rule>(node)) {
+            result.push_back(std::get_if<Rule>(&node));
+        }
+    }
+    return result;
+}
+
+Rule* Grammar::get_rule(const std::string& name) {
+    return get_symbols().get_rule(name);
+}
+
+std::vector<Reference*> Grammar::get_references(const std::string& name) {
+    return get_symbols().get_references(name);
+}
+
+bool Grammar::is_recursive(const Rule& rule) {
+    return get_symbols().is_recursive(rule);
+}
+
+void Grammar::modified(const Rule& rule) {
+    std::lock_guard<std::mutex> guard(lock);
+    hash_valid = false;
+    symbols.modified(rule);
 }
 
 std::string Grammar::dump_graph(const std::string& title) const {
@@ -164,7 +490,7 @@ std::string Grammar::dump_graph(const std::string& title) const {
             continue;
         }
         Rule* rule = std::get_if<Rule>(&node)->as<Rule>();
-        std::vector<Reference*> refs = rule->find_children<Reference>([](const Reference& ref) { return true; });
+        std::vector<Reference*> refs = rule->find_children<Reference>();
         std::set<std::string> processed_refs;
         for (Reference* ref: refs) {
             std::string ref_name = ref->get_name();
@@ -1,33 +1,99 @@
 #pragma once
+#include "ast/arena.h"
 #include "ast/code.h"
 #include "ast/directive.h"
 #include "ast/node.h"
+#include "ast/node_list.h"
 #include "ast/reference.h"
 #include "ast/rule.h"
+#include "ast/symbol_table.h"
+
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+
+class FormatCache;
 
 using TopLevel = std::variant<std::monostate, Directive, Rule>;
 
 class Grammar: public Node {
-    std::vector<TopLevel> nodes;
+    // must be declared first, so that it is destroyed after all the nodes
+    std::shared_ptr<Arena> arena;
+    NodeList<TopLevel> nodes;
     Code code;
     std::string input_file;
     int importLevel;
+    SymbolTable symbols;
+    std::mutex lock; // guards symbols and hash of the grammar while rules are optimized in parallel
+
+    SymbolTable& get_symbols();
+
+    // imported files, parsed separately and indexed by canonical path
+    using ImportedFiles = std::map<std::string, std::shared_ptr<const Grammar>>;
+    Grammar(Parser& p, const std::string& input_file, int importLevel);
+    static std::string find_import(const Directive& d, const std::vector<std::string>& dirs);
+    static std::shared_ptr<const Grammar> load_import(const std::string& path);
+    void load_imports();
+    void splice_imports(
+        const Grammar& file,
+        int level,
+        ImportedFiles& files,
+        const std::vector<std::string>& dirs,
+        std::set<std::string>& done,
+        NodeList<TopLevel>& result,
+        Code& imported_code
+    );
 
 public:
+    static const NodeKind KIND = NK_GRAMMAR;
+
     Grammar(const std::vector<TopLevel>& nodes, const Code& code, const std::string& input_file);
     Grammar(Parser& p, const std::string& input_file);
     Grammar(const std::string& p, const std::string& input_file);
+    // the copy shares the arena with the original
+    Grammar(const Grammar& other);
+
+    // Returns canonical paths of all files imported from the input file, directly or indirectly.
+    static std::set<std::string> find_imported_files(const std::string& input_file);
+    // Returns the same text as to_string() of the parsed (not optimized) grammar, but rules that did not change
+    // since the previous run are not parsed at all, their formatted text is taken from the cache instead.
+    static std::string format(std::string_view content, const std::string& input_file, FormatCache& cache);
 
     virtual void parse(Parser& p) override;
     virtual std::string to_string(std::string indent = "") const override;
     virtual std::string dump(std::string indent = "") const override;
     virtual bool is_multiline() const override;
-    virtual size_t hash() const override;
+    virtual size_t compute_hash() const override;
 
     virtual Node* operator[](int index) override;
     virtual long size() const override;
 
     void erase(Rule* rule);
 
+    Arena* get_arena() const;
+    const std::string& get_input_file() const;
+
+    std::vector<Rule*> get_rules();
+    Rule* get_rule(const std::string& name);
+    std::vector<Reference*> get_references(const std::string& name);
+    bool is_recursive(const Rule& rule);
+    void modified(const Rule& rule);
+
     std::string dump_graph(const std::string& title) const;
+
+    template<class F> friend bool for_each_child(Node& node, F&& fn);
+};
+
+// Collects canonical paths of the files imported by the grammars parsed in the current thread, while it exists.
+// The result stays empty if the imports were not followed, e.g. when the grammar was only formatted.
+class ImportCapture {
+    ImportCapture* previous;
+    std::optional<std::set<std::string>>& files;
+
+    friend class Grammar;
+
+public:
+    ImportCapture(std::optional<std::set<std::string>>& files);
+    ~ImportCapture();
 };
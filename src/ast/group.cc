@@ -5,11 +5,24 @@
 #include "utils.h"
 
 Group::Group(const Alternation& expression, Node* parent):
-    Node("Group", parent), expression(new Alternation(expression)) {}
-Group::Group(Parser& p, Node* parent): Node("Group", parent) {
+    Node(NK_GROUP, parent), expression(NodePtr<Alternation>::make(expression)) {}
+Group::Group(Parser& p, Node* parent): Node(NK_GROUP, parent) {
     parse(p);
 }
 
+// Copies must not share the subtree, otherwise modifying one copy would silently change all the others.
+Group::Group(const Group& other): Node(other), expression(other.expression.clone()) {}
+
+Group::~Group() {}
+
+Group& Group::operator=(const Group& other) {
+    // other might be a descendant of this group, so it has to be copied before the old subtree is released
+    NodePtr<Alternation> copy = other.expression.clone();
+    Node::operator=(other);
+    expression = std::move(copy);
+    return *this;
+}
+
 void Group::parse(Parser& p) {
     debug("Parsing Group");
     DebugIndent _;
@@ -19,7 +32,7 @@ void Group::parse(Parser& p) {
         s.rollback();
         return;
     }
-    expression.reset(new Alternation(p, this));
+    expression = NodePtr<Alternation>::make(p, this);
     if (!*expression) {
         s.rollback();
         return;
@@ -57,7 +70,7 @@ bool Group::is_multiline() const {
 
 const size_t GROUP_HASH = std::hash<const char*> {}("group");
 
-size_t Group::hash() const {
+size_t Group::compute_hash() const {
     return combine(GROUP_HASH, expression->hash());
 }
 
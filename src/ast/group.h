@@ -1,4 +1,5 @@
 #pragma once
+#include "ast/arena.h"
 #include "ast/node.h"
 
 class Alternation;
@@ -6,17 +7,22 @@ class Sequence;
 class Term;
 
 class Group: public Node {
-    std::shared_ptr<Alternation> expression;
+    NodePtr<Alternation> expression;
 
 public:
+    static const NodeKind KIND = NK_GROUP;
+
     Group(const Alternation& expression, Node* parent);
     Group(Parser& p, Node* parent);
+    Group(const Group& other);
+    Group& operator=(const Group& other);
+    virtual ~Group();
 
     virtual void parse(Parser& p) override;
     virtual std::string to_string(std::string indent = "") const override;
     virtual std::string dump(std::string = "") const override;
     virtual bool is_multiline() const override;
-    virtual size_t hash() const override;
+    virtual size_t compute_hash() const override;
 
     virtual Node* operator[](int index) override;
     virtual long size() const override;
@@ -28,6 +34,7 @@ public:
     const Alternation& convert_to_alternation() const;
 
     friend bool operator==(const Group& a, const Group& b);
+    template<class F> friend bool for_each_child(Node& node, F&& fn);
 };
 
 bool operator==(const Group& a, const Group& b);
@@ -4,8 +4,8 @@
 #include "log.h"
 #include "utils.h"
 
-Marker::Marker(const std::string& name, Node* parent): Node("Marker", parent), name(name) {}
-Marker::Marker(Parser& p, Node* parent): Node("Marker", parent) {
+Marker::Marker(const std::string& name, Node* parent): Node(NK_MARKER, parent), name(name) {}
+Marker::Marker(Parser& p, Node* parent): Node(NK_MARKER, parent) {
     parse(p);
 }
 
@@ -14,7 +14,7 @@ void Marker::parse(Parser& p) {
     DebugIndent _;
     Parser::State s = p.save_point();
     if (p.match('@') && p.match_identifier()) {
-        name = p.last_re_match.str(0);
+        name = trim(p.last_match);
         s.commit();
         valid = true;
     } else {
@@ -36,7 +36,7 @@ bool Marker::is_multiline() const {
 
 const size_t MARKER_HASH = std::hash<const char*> {}("marker");
 
-size_t Marker::hash() const {
+size_t Marker::compute_hash() const {
     return combine(MARKER_HASH, name);
 }
 
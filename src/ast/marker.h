@@ -5,6 +5,8 @@ class Marker: public Node {
     std::string name;
 
 public:
+    static const NodeKind KIND = NK_MARKER;
+
     Marker(const std::string& name, Node* parent);
     Marker(Parser& p, Node* parent);
 
@@ -12,7 +14,7 @@ public:
     virtual std::string to_string(std::string indent = "") const override;
     virtual std::string dump(std::string = "") const override;
     virtual bool is_multiline() const override;
-    virtual size_t hash() const override;
+    virtual size_t compute_hash() const override;
 
     friend bool operator==(const Marker& a, const Marker& b);
 };
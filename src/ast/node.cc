@@ -1,12 +1,33 @@
 #include "ast/node.h"
 
 #include "ast/grammar.h"
+#include "ast/visitor.h"
 #include "log.h"
 
-Node::Node(const char* type, Node* parent): valid(false), parent(parent), type(type) {
+static const char* kind_name(NodeKind kind) {
+    static const char* names[] = {
+        "Action", "Alternation", "Capture", "CharacterClass", "Code", "Directive", "Expand", "Grammar", "Group",
+        "Marker", "Position", "Predicate", "Reference", "Rule", "Sequence", "String", "Term",
+    };
+    return names[kind];
+}
+
+Node::Node(NodeKind kind, Node* parent):
+    valid(false), parent(parent), kind(kind), type(kind_name(kind)), hash_value(0), hash_valid(false) {
     debug("Creating %s @%p, parent: %p", type, this, parent);
 }
 
+Node& Node::operator=(const Node& other) {
+    valid = other.valid;
+    kind = other.kind;
+    type = other.type;
+    comments = other.comments;
+    post_comment = other.post_comment;
+    hash_value = other.hash_value;
+    hash_valid = other.hash_valid;
+    return *this;
+}
+
 Node::~Node() {}
 
 Node::operator bool() const {
@@ -26,7 +47,7 @@ void Node::parse_comments(Parser& p, bool store) {
     p.skip_space();
     while (p.match_comment()) {
         if (store) {
-            std::string comment = p.last_match;
+            std::string comment(p.last_match);
             if (!comment.empty() && comment.back() == '\n') {
                 comment.pop_back();
             }
@@ -78,19 +99,6 @@ std::string Node::dump_comments() const {
     return " (" + result + ")";
 }
 
-bool Node::map(const std::function<bool(Node&)>& transform) {
-    if (transform(*this)) {
-        return true;
-    }
-    for (int i = 0; i < size(); i++) {
-        Node* n = (*this)[i];
-        if (n->map(transform)) {
-            return true;
-        }
-    }
-    return false;
-}
-
 bool Node::is_descendant_of(Node* n) const {
     if (!parent) {
         return false;
@@ -101,13 +109,47 @@ bool Node::is_descendant_of(Node* n) const {
     return parent->is_descendant_of(n);
 }
 
+void Node::adopt(Node& child) {
+    child.parent = this;
+    child.update_parents();
+}
+
 void Node::update_parents() {
-    for (int i = 0; i < size(); i++) {
-        Node* n = (*this)[i];
-        //~ debug("Updating parent of %s@%p, parent: %p -> %p%s", n->type, n, n->parent, this, n->parent == this ? " (NO
-        // CHANGE)" : "");
-        n->parent = this;
-        n->update_parents();
+    for_each_child(*this, [this](Node& child) {
+        child.parent = this;
+        child.update_parents();
+        return false;
+    });
+}
+
+size_t Node::hash() const {
+    if (!hash_valid) {
+        hash_value = compute_hash();
+        hash_valid = true;
+    }
+    return hash_value;
+}
+
+void Node::check_hashes() {
+    // children first, so that compute_hash() below only relies on already verified values
+    for_each_child(*this, [](Node& child) {
+        child.check_hashes();
+        return false;
+    });
+    if (hash_valid && hash_value != compute_hash()) {
+        error(INTERNAL_ERROR, "Cached hash of %s is out of date: %s", type, to_string().c_str());
+    }
+}
+
+void Node::modified() {
+    Node* child = nullptr;
+    for (Node* n = this; n; child = n, n = n->parent) {
+        if (n->is<Grammar>() && child && child->is<Rule>()) {
+            // other rules might be modified at the same time, so the grammar handles this on its own
+            n->as<Grammar>()->modified(*child->as<Rule>());
+            return;
+        }
+        n->hash_valid = false;
     }
 }
 
@@ -125,7 +167,7 @@ bool Node::has_post_comment() const {
     }
 
 bool operator==(const Node& a, const Node& b) {
-    if (a.type != b.type) {
+    if (a.kind != b.kind) {
         return false;
     }
     CMP(Action);
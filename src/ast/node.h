@@ -6,26 +6,69 @@
 #include <string>
 #include <variant>
 
+// Concrete type of a node, used instead of RTTI in Node::is() and in the typed visitor (see visitor.h).
+enum NodeKind {
+    NK_ACTION,
+    NK_ALTERNATION,
+    NK_CAPTURE,
+    NK_CHARACTER_CLASS,
+    NK_CODE,
+    NK_DIRECTIVE,
+    NK_EXPAND,
+    NK_GRAMMAR,
+    NK_GROUP,
+    NK_MARKER,
+    NK_POSITION,
+    NK_PREDICATE,
+    NK_REFERENCE,
+    NK_RULE,
+    NK_SEQUENCE,
+    NK_STRING,
+    NK_TERM,
+};
+
+class Node;
+
+// Calls fn(child) for each direct child of node, stops as soon as fn returns true.
+template<class F> bool for_each_child(Node& node, F&& fn);
+
 class Node {
 protected:
     bool valid;
     Node* parent;
-    Node(const char* type, Node* parent);
+    Node(NodeKind kind, Node* parent);
+    Node(const Node& other) = default;
+    // Assignment only replaces the content, the node keeps its place in the tree.
+    Node& operator=(const Node& other);
     virtual ~Node();
 
+    void adopt(Node& child);
+
+    NodeKind kind;
     const char* type;
     std::vector<std::string> comments;
     std::string post_comment;
 
+    // memoized result of compute_hash(), reset by modified()
+    mutable size_t hash_value;
+    mutable bool hash_valid;
+
 public:
     virtual void parse(Parser& p) = 0;
     virtual std::string to_string(std::string indent = "") const = 0;
     virtual std::string dump(std::string indent = "") const = 0;
     virtual bool is_multiline() const = 0;
-    virtual size_t hash() const = 0;
+    virtual size_t compute_hash() const = 0;
+
+    size_t hash() const;
+    void check_hashes();
 
     operator bool() const;
 
+    NodeKind get_kind() const {
+        return kind;
+    }
+
     template<class U> bool is() const;
 
     template<class U> U* as() const;
@@ -41,22 +84,15 @@ public:
     virtual long size() const;
 
     void update_parents();
+    void modified();
 
-    template<class U>
-    std::vector<U*> find_children(const std::function<bool(const U&)>& predicate = [](const U& node) -> bool {
-        return true;
-    });
-
-    template<class U> void find_children(std::vector<U*>& result, const std::function<bool(const U&)>& predicate);
-
-    template<class U>
-    std::vector<U*> find_ancestors(const std::function<bool(const U&)>& predicate = [](const U& node) -> bool {
-        return true;
-    });
-
-    template<class U> void find_ancestors(std::vector<U*>& result, const std::function<bool(const U&)>& predicate);
+    // defined in visitor.h
+    template<class U> std::vector<U*> find_children();
+    template<class U, class P> std::vector<U*> find_children(P&& predicate);
+    template<class F> bool map(F&& transform);
 
-    bool map(const std::function<bool(Node&)>& transform);
+    template<class U> std::vector<U*> find_ancestors();
+    template<class U, class P> std::vector<U*> find_ancestors(P&& predicate);
 
     void parse_comments(Parser& p, bool store = true);
     void parse_post_comment(Parser& p);
@@ -70,14 +106,14 @@ public:
 };
 
 template<class U> bool Node::is() const {
-    return typeid(*this) == typeid(U);
+    return kind == U::KIND;
 }
 
 template<class U> U* Node::as() const {
-    if (!is<U>()) {
+    if (kind != U::KIND) {
         return nullptr;
     }
-    return (U*)this;
+    return static_cast<U*>(const_cast<Node*>(this));
 }
 
 template<class U> U* Node::get_parent() const {
@@ -98,35 +134,18 @@ template<class U> U* Node::get_ancestor() const {
     }
 }
 
-template<class U> std::vector<U*> Node::find_children(const std::function<bool(const U&)>& predicate) {
-    std::vector<U*> result;
-    find_children(result, predicate);
-    return result;
-}
-
-template<class U> void Node::find_children(std::vector<U*>& result, const std::function<bool(const U&)>& predicate) {
-    if (is<U>() && predicate(*(U*)this)) {
-        result.push_back((U*)(this));
-    }
-    for (int i = 0; i < size(); i++) {
-        Node* n = (*this)[i];
-        n->find_children(result, predicate);
-    }
+template<class U> std::vector<U*> Node::find_ancestors() {
+    return find_ancestors<U>([](const U& node) { return true; });
 }
 
-template<class U> std::vector<U*> Node::find_ancestors(const std::function<bool(const U&)>& predicate) {
+template<class U, class P> std::vector<U*> Node::find_ancestors(P&& predicate) {
     std::vector<U*> result;
-    find_ancestors(result, predicate);
-    return result;
-}
-
-template<class U> void Node::find_ancestors(std::vector<U*>& result, const std::function<bool(const U&)>& predicate) {
-    if (is<U>() && predicate(*(U*)this)) {
-        result.push_back((U*)(this));
-    }
-    if (parent) {
-        parent->find_ancestors(result, predicate);
+    for (Node* n = this; n; n = n->parent) {
+        if (U* u = n->as<U>(); u && predicate(*u)) {
+            result.push_back(u);
+        }
     }
+    return result;
 }
 
 bool operator==(const Node& a, const Node& b);
@@ -0,0 +1,155 @@
+#pragma once
+#include "ast/arena.h"
+
+#include <iterator>
+#include <vector>
+
+// Owning list of child nodes. Each item is allocated separately (from the arena that was
+// active when the list allocated its first item), so inserting or erasing items never moves
+// the others. Pointers to the items (and parent pointers of their descendants) stay valid
+// until the item itself is erased.
+template<class T> class NodeList {
+    Arena* arena;
+    std::vector<T*> items;
+
+    T* create(const T& value) {
+        if (!arena) {
+            arena = Arena::current();
+        }
+        return arena->create<T>(value);
+    }
+
+    void clear() {
+        for (T* item: items) {
+            arena->destroy(item);
+        }
+        items.clear();
+    }
+
+public:
+    template<class V, class I> class Iterator {
+        I it;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = V*;
+        using reference = V&;
+
+        Iterator(I it): it(it) {}
+        V& operator*() const {
+            return **it;
+        }
+        V* operator->() const {
+            return *it;
+        }
+        Iterator& operator++() {
+            ++it;
+            return *this;
+        }
+        bool operator==(const Iterator& other) const {
+            return it == other.it;
+        }
+        bool operator!=(const Iterator& other) const {
+            return it != other.it;
+        }
+    };
+    using iterator = Iterator<T, typename std::vector<T*>::iterator>;
+    using const_iterator = Iterator<const T, typename std::vector<T*>::const_iterator>;
+
+    NodeList(): arena(nullptr) {}
+
+    NodeList(const std::vector<T>& values): arena(nullptr) {
+        for (const T& value: values) {
+            push_back(value);
+        }
+    }
+
+    NodeList(const NodeList& other): arena(nullptr) {
+        items.reserve(other.items.size());
+        for (const T* item: other.items) {
+            push_back(*item);
+        }
+    }
+
+    NodeList(NodeList&& other) noexcept: arena(other.arena), items(std::move(other.items)) {
+        other.items.clear();
+    }
+
+    NodeList& operator=(const NodeList& other) {
+        NodeList copy(other);
+        std::swap(arena, copy.arena);
+        items.swap(copy.items);
+        return *this;
+    }
+
+    NodeList& operator=(NodeList&& other) noexcept {
+        std::swap(arena, other.arena);
+        items.swap(other.items);
+        return *this;
+    }
+
+    ~NodeList() {
+        clear();
+    }
+
+    T& operator[](int index) {
+        return *items[index];
+    }
+
+    const T& operator[](int index) const {
+        return *items[index];
+    }
+
+    long size() const {
+        return items.size();
+    }
+
+    bool empty() const {
+        return items.empty();
+    }
+
+    iterator begin() {
+        return iterator(items.begin());
+    }
+
+    iterator end() {
+        return iterator(items.end());
+    }
+
+    const_iterator begin() const {
+        return const_iterator(items.begin());
+    }
+
+    const_iterator end() const {
+        return const_iterator(items.end());
+    }
+
+    void push_back(const T& value) {
+        items.push_back(create(value));
+    }
+
+    void insert(int index, const NodeList& other) {
+        std::vector<T*> copies;
+        copies.reserve(other.items.size());
+        for (const T* item: other.items) {
+            copies.push_back(create(*item));
+        }
+        items.insert(items.begin() + index, copies.begin(), copies.end());
+    }
+
+    void erase(int index) {
+        arena->destroy(items[index]);
+        items.erase(items.begin() + index);
+    }
+
+    int find(const T* item) const {
+        for (int i = 0; i < items.size(); i++) {
+            if (items[i] == item) {
+                return i;
+            }
+        }
+        return -1;
+    }
+};
@@ -4,8 +4,8 @@
 #include "log.h"
 #include "utils.h"
 
-Position::Position(Node* parent): Node("Position", parent) {}
-Position::Position(Parser& p, Node* parent): Node("Position", parent) {
+Position::Position(Node* parent): Node(NK_POSITION, parent) {}
+Position::Position(Parser& p, Node* parent): Node(NK_POSITION, parent) {
     parse(p);
 }
 
@@ -29,7 +29,7 @@ bool Position::is_multiline() const {
 
 const size_t POSITION_HASH = std::hash<const char*> {}("position");
 
-size_t Position::hash() const {
+size_t Position::compute_hash() const {
     return POSITION_HASH;
 }
 
@@ -3,6 +3,8 @@
 
 class Position: public Node {
 public:
+    static const NodeKind KIND = NK_POSITION;
+
     Position(Node* parent);
     Position(Parser& p, Node* parent);
 
@@ -10,7 +12,7 @@ public:
     virtual std::string to_string(std::string indent = "") const override;
     virtual std::string dump(std::string = "") const override;
     virtual bool is_multiline() const override;
-    virtual size_t hash() const override;
+    virtual size_t compute_hash() const override;
 
     friend bool operator==(const Position& a, const Position& b);
 };
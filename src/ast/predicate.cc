@@ -3,8 +3,9 @@
 #include "log.h"
 #include "utils.h"
 
-Predicate::Predicate(Node* parent, std::string code, bool negative): Action(code, parent), negative(negative) {}
-Predicate::Predicate(Parser& p, Node* parent): Action(parent) {
+Predicate::Predicate(Node* parent, std::string code, bool negative):
+    Action(NK_PREDICATE, code, parent), negative(negative) {}
+Predicate::Predicate(Parser& p, Node* parent): Action(NK_PREDICATE, "", parent) {
     parse(p);
 }
 
@@ -38,8 +39,8 @@ std::string Predicate::dump(std::string indent) const {
 
 const size_t PREDICATE_HASH = std::hash<const char*> {}("predicate");
 
-size_t Predicate::hash() const {
-    return combine(PREDICATE_HASH + negative, Action::hash());
+size_t Predicate::compute_hash() const {
+    return combine(PREDICATE_HASH + negative, Action::compute_hash());
 }
 
 bool operator==(const Predicate& a, const Predicate& b) {
@@ -5,13 +5,15 @@ class Predicate: public Action {
     bool negative;
 
 public:
+    static const NodeKind KIND = NK_PREDICATE;
+
     Predicate(Node* parent, std::string code, bool negative);
     Predicate(Parser& p, Node* parent);
 
     virtual void parse(Parser& p) override;
     virtual std::string to_string(std::string indent = "") const override;
     virtual std::string dump(std::string = "") const override;
-    virtual size_t hash() const override;
+    virtual size_t compute_hash() const override;
 
     friend bool operator==(const Predicate& a, const Predicate& b);
 };
@@ -5,8 +5,8 @@
 #include "utils.h"
 
 Reference::Reference(const std::string& name, const std::string& var, Node* parent):
-    Node("Reference", parent), name(name), var(var) {}
-Reference::Reference(Parser& p, Node* parent): Node("Reference", parent) {
+    Node(NK_REFERENCE, parent), name(name), var(var) {}
+Reference::Reference(Parser& p, Node* parent): Node(NK_REFERENCE, parent) {
     parse(p);
 }
 
@@ -16,12 +16,12 @@ void Reference::parse(Parser& p) {
     if (!p.match_identifier()) {
         return;
     }
-    std::string p1 = p.last_match;
+    std::string p1(p.last_match);
     if (p.match(":")) {
         if (!p.match_identifier()) {
             error(PARSING_ERROR, "expected identifier!\n");
         }
-        std::string p2 = p.last_match;
+        std::string p2(p.last_match);
         name = p2;
         var = p1;
     } else {
@@ -51,7 +51,7 @@ bool Reference::is_multiline() const {
     return false;
 }
 
-size_t Reference::hash() const {
+size_t Reference::compute_hash() const {
     return combine(std::hash<std::string> {}(name), std::hash<std::string> {}(var));
 }
 
@@ -61,6 +61,7 @@ std::string Reference::get_name() const {
 
 void Reference::set_name(const std::string& new_name) {
     name = new_name;
+    modified();
 }
 
 bool Reference::references(const Rule* rule) const {
@@ -72,7 +73,8 @@ bool Reference::has_variable() const {
 }
 
 void Reference::remove_variable() {
-    return var.clear();
+    var.clear();
+    modified();
 }
 
 bool operator==(const Reference& a, const Reference& b) {
@@ -9,6 +9,8 @@ class Reference: public Node {
     std::string var;
 
 public:
+    static const NodeKind KIND = NK_REFERENCE;
+
     Reference(const std::string& name, const std::string& var, Node* parent);
     Reference(Parser& p, Node* parent);
 
@@ -16,7 +18,7 @@ public:
     virtual std::string to_string(std::string indent = "") const override;
     virtual std::string dump(std::string indent = "") const override;
     virtual bool is_multiline() const override;
-    virtual size_t hash() const override;
+    virtual size_t compute_hash() const override;
 
     std::string get_name() const;
     void set_name(const std::string& new_name);
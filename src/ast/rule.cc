@@ -1,12 +1,13 @@
 #include "ast/rule.h"
 
+#include "ast/visitor.h"
 #include "config.h"
 #include "log.h"
 #include "utils.h"
 
 Rule::Rule(const std::string& name, const Alternation& expression, Node* parent):
-    Node("Rule", parent), name(name), expression(expression) {}
-Rule::Rule(Parser& p, Node* parent): Node("Rule", parent), expression(this) {
+    Node(NK_RULE, parent), name(name), expression(expression) {}
+Rule::Rule(Parser& p, Node* parent): Node(NK_RULE, parent), expression(this) {
     parse(p);
 }
 
@@ -52,7 +53,7 @@ bool Rule::is_multiline() const {
 
 const size_t RULE_HASH = std::hash<const char*> {}("rule");
 
-size_t Rule::hash() const {
+size_t Rule::compute_hash() const {
     return combine(RULE_HASH, expression.hash());
 }
 
@@ -91,12 +92,11 @@ Group Rule::convert_to_group() const {
 }
 
 bool Rule::contains_alternation() {
-    auto predicate = [](const Alternation& alternation) -> bool { return alternation.size() > 1; };
-    return find_children<Alternation>(predicate).size() > 0;
+    return find_first<Alternation>(*this, [](const Alternation& alternation) { return alternation.size() > 1; });
 }
 
 bool Rule::contains_expand() {
-    return find_children<Expand>().size() > 0;
+    return find_first<Expand>(*this);
 }
 
 int Rule::count_terms() {
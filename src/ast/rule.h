@@ -9,6 +9,8 @@ class Rule: public Node {
     Alternation expression;
 
 public:
+    static const NodeKind KIND = NK_RULE;
+
     Rule(const std::string& name, const Alternation& expression, Node* parent);
     Rule(Parser& p, Node* parent);
 
@@ -16,7 +18,7 @@ public:
     virtual std::string to_string(std::string indent = "") const override;
     virtual std::string dump(std::string indent = "") const override;
     virtual bool is_multiline() const override;
-    virtual size_t hash() const override;
+    virtual size_t compute_hash() const override;
 
     virtual Node* operator[](int index) override;
     virtual long size() const override;
@@ -34,6 +36,7 @@ public:
 
     friend class Reference;
     friend bool operator==(const Rule& a, const Rule& b);
+    template<class F> friend bool for_each_child(Node& node, F&& fn);
 };
 
 bool operator==(const Rule& a, const Rule& b);
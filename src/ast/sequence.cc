@@ -3,8 +3,8 @@
 #include "log.h"
 #include "utils.h"
 
-Sequence::Sequence(const std::vector<Term>& terms, Node* parent): Node("Sequence", parent), terms(terms) {}
-Sequence::Sequence(Parser& p, Node* parent): Node("Sequence", parent) {
+Sequence::Sequence(const std::vector<Term>& terms, Node* parent): Node(NK_SEQUENCE, parent), terms(terms) {}
+Sequence::Sequence(Parser& p, Node* parent): Node(NK_SEQUENCE, parent) {
     parse(p);
 }
 
@@ -64,7 +64,7 @@ bool Sequence::is_multiline() const {
     return std::any_of(terms.begin(), terms.end(), ::is_multiline);
 }
 
-size_t Sequence::hash() const {
+size_t Sequence::compute_hash() const {
     size_t hash = 0;
     for (const Term& t: terms) {
         hash = combine(hash, t.hash());
@@ -101,17 +101,25 @@ long Sequence::size() const {
 }
 
 void Sequence::insert(int index, const Sequence& s) {
-    terms.insert(terms.begin() + index, s.terms.begin(), s.terms.end());
+    terms.insert(index, s.terms);
+    for (int i = index; i < index + s.size(); i++) {
+        adopt(terms[i]);
+    }
+    modified();
 }
 
 void Sequence::erase(Term* term) {
-    std::vector<Term>::iterator it =
-        std::find_if(terms.begin(), terms.end(), [term](const Term& t) { return &t == term; });
-    terms.erase(it);
+    int index = terms.find(term);
+    if (index < 0) {
+        return;
+    }
+    terms.erase(index);
+    modified();
 }
 
 void Sequence::erase(int index) {
-    terms.erase(terms.begin() + index);
+    terms.erase(index);
+    modified();
 }
 
 bool operator==(const Sequence& a, const Sequence& b) {
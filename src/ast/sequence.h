@@ -1,11 +1,14 @@
 #pragma once
 #include "ast/node.h"
+#include "ast/node_list.h"
 #include "ast/term.h"
 
 class Sequence: public Node {
-    std::vector<Term> terms;
+    NodeList<Term> terms;
 
 public:
+    static const NodeKind KIND = NK_SEQUENCE;
+
     Sequence(const std::vector<Term>& terms, Node* parent);
     Sequence(Parser& p, Node* parent);
 
@@ -13,7 +16,7 @@ public:
     virtual std::string to_string(std::string indent = "") const override;
     virtual std::string dump(std::string indent = "") const override;
     virtual bool is_multiline() const override;
-    virtual size_t hash() const override;
+    virtual size_t compute_hash() const override;
 
     virtual Node* operator[](int index) override;
     virtual long size() const override;
@@ -29,6 +32,7 @@ public:
     void erase(int index);
 
     friend bool operator==(const Sequence& a, const Sequence& b);
+    template<class F> friend bool for_each_child(Node& node, F&& fn);
 };
 
 bool operator==(const Sequence& a, const Sequence& b);
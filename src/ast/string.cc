@@ -4,8 +4,8 @@
 #include "log.h"
 #include "utils.h"
 
-String::String(const std::string& content, Node* parent): Node("String", parent), content(content) {}
-String::String(Parser& p, Node* parent): Node("String", parent) {
+String::String(const std::string& content, Node* parent): Node(NK_STRING, parent), content(content) {}
+String::String(Parser& p, Node* parent): Node(NK_STRING, parent) {
     parse(p);
 }
 
@@ -19,7 +19,7 @@ void String::parse(Parser& p) {
 }
 
 std::string String::to_string(std::string indent) const {
-    if (Config::get<Config::QuoteType>("quotes") == Config::QT_SINGLE) {
+    if (Config::settings().quotes == Config::QT_SINGLE) {
         return '\'' + ::to_c_string(content, ESCAPE_SINGLE_QUOTES) + '\'';
     } else {
         return '"' + ::to_c_string(content, ESCAPE_DOUBLE_QUOTES) + '"';
@@ -36,7 +36,7 @@ bool String::is_multiline() const {
 
 const size_t STRING_HASH = std::hash<const char*> {}("string");
 
-size_t String::hash() const {
+size_t String::compute_hash() const {
     return combine(STRING_HASH, content);
 }
 
@@ -50,6 +50,7 @@ std::string String::to_c_string() const {
 
 void String::append(const String& str) {
     content.append(str.content);
+    modified();
 }
 
 bool operator==(const String& a, const String& b) {
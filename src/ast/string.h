@@ -5,6 +5,8 @@ class String: public Node {
     std::string content;
 
 public:
+    static const NodeKind KIND = NK_STRING;
+
     String(const std::string& content, Node* parent);
     String(Parser& p, Node* parent);
 
@@ -12,7 +14,7 @@ public:
     virtual std::string to_string(std::string indent = "") const override;
     virtual std::string dump(std::string = "") const override;
     virtual bool is_multiline() const override;
-    virtual size_t hash() const override;
+    virtual size_t compute_hash() const override;
 
     const char* c_str() const;
     std::string to_c_string() const;
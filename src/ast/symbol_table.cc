@@ -0,0 +1,126 @@
+#include "ast/symbol_table.h"
+
+#include "ast/reference.h"
+#include "ast/rule.h"
+#include "ast/visitor.h"
+#include "log.h"
+
+#include <algorithm>
+
+SymbolTable::SymbolTable(): built(false) {}
+
+SymbolTable::SymbolTable(const SymbolTable& other): built(false) {}
+
+SymbolTable& SymbolTable::operator=(const SymbolTable& other) {
+    reset();
+    return *this;
+}
+
+void SymbolTable::reset() {
+    built = false;
+    rules.clear();
+    positions.clear();
+    references.clear();
+    targets.clear();
+    stale.clear();
+}
+
+bool SymbolTable::is_built() const {
+    return built;
+}
+
+void SymbolTable::build(const std::vector<Rule*>& all_rules) {
+    debug("Building symbol table for %d rules", (int)all_rules.size());
+    reset();
+    for (int i = 0; i < all_rules.size(); i++) {
+        rules[all_rules[i]->get_name()] = all_rules[i];
+        positions[all_rules[i]->get_name()] = i;
+    }
+    for (Rule* rule: all_rules) {
+        index(rule);
+    }
+    built = true;
+}
+
+void SymbolTable::refresh() {
+    for (const std::string& name: stale) {
+        debug("Re-indexing references in rule %s", name.c_str());
+        unindex(name);
+        index(rules[name]);
+    }
+    stale.clear();
+}
+
+void SymbolTable::unindex(const std::string& name) {
+    for (const std::string& target: targets[name]) {
+        std::vector<Entry>& entries = references[target];
+        entries.erase(
+            std::remove_if(entries.begin(), entries.end(), [&name](const Entry& e) { return e.owner == name; }),
+            entries.end()
+        );
+        if (entries.empty()) {
+            references.erase(target);
+        }
+    }
+    targets.erase(name);
+}
+
+void SymbolTable::index(Rule* rule) {
+    // Group the references by target first, so that each list is only searched once. Lists are kept
+    // sorted by position of the owning rule, so references are always returned in document order.
+    const std::string name = rule->get_name();
+    std::map<std::string, std::vector<Entry>> found;
+    for (Reference* ref: rule->find_children<Reference>()) {
+        found[ref->get_name()].push_back({name, ref});
+    }
+    int position = positions[name];
+    for (auto& [target, new_entries]: found) {
+        std::vector<Entry>& entries = references[target];
+        std::vector<Entry>::iterator it =
+            std::find_if(entries.begin(), entries.end(), [this, position](const Entry& e) {
+                return positions[e.owner] > position;
+            });
+        entries.insert(it, new_entries.begin(), new_entries.end());
+        targets[name].insert(target);
+    }
+}
+
+Rule* SymbolTable::get_rule(const std::string& name) {
+    std::map<std::string, Rule*>::iterator it = rules.find(name);
+    return it == rules.end() ? nullptr : it->second;
+}
+
+std::vector<Reference*> SymbolTable::get_references(const std::string& name) {
+    refresh();
+    std::vector<Reference*> result;
+    std::map<std::string, std::vector<Entry>>::iterator it = references.find(name);
+    if (it != references.end()) {
+        for (const Entry& e: it->second) {
+            result.push_back(e.ref);
+        }
+    }
+    return result;
+}
+
+bool SymbolTable::is_recursive(const Rule& rule) {
+    refresh();
+    std::map<std::string, std::set<std::string>>::iterator it = targets.find(rule.get_name());
+    return it != targets.end() && it->second.count(rule.get_name());
+}
+
+void SymbolTable::modified(const Rule& rule) {
+    if (built && rules.count(rule.get_name())) {
+        stale.insert(rule.get_name());
+    }
+}
+
+void SymbolTable::erase(const Rule& rule) {
+    if (!built) {
+        return;
+    }
+    const std::string name = rule.get_name();
+    unindex(name);
+    rules.erase(name);
+    positions.erase(name);
+    stale.erase(name);
+}
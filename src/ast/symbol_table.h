@@ -0,0 +1,46 @@
+#pragma once
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+class Reference;
+class Rule;
+
+// Maps rule names to their definitions and to all references pointing to them.
+// After the initial build, the table is kept up to date rule by rule: modified
+// rules are only marked as stale and get re-indexed when the table is queried.
+class SymbolTable {
+    struct Entry {
+        std::string owner; // name of the rule containing the reference
+        Reference* ref;
+    };
+
+    bool built;
+    std::map<std::string, Rule*> rules;
+    std::map<std::string, int> positions;
+    std::map<std::string, std::vector<Entry>> references;
+    std::map<std::string, std::set<std::string>> targets;
+    std::set<std::string> stale;
+
+    void reset();
+    void refresh();
+    void unindex(const std::string& name);
+    void index(Rule* rule);
+
+public:
+    SymbolTable();
+    // Pointers in the table belong to the original tree, so copies always start empty.
+    SymbolTable(const SymbolTable& other);
+    SymbolTable& operator=(const SymbolTable& other);
+
+    bool is_built() const;
+    void build(const std::vector<Rule*>& all_rules);
+
+    Rule* get_rule(const std::string& name);
+    std::vector<Reference*> get_references(const std::string& name);
+    bool is_recursive(const Rule& rule);
+
+    void modified(const Rule& rule);
+    void erase(const Rule& rule);
+};
@@ -3,23 +3,25 @@
 #include "log.h"
 #include "utils.h"
 
-template<typename T, typename U = const Node> struct PrimaryVisitor {
-    PrimaryVisitor(std::function<T(U&)> f): fn(f) {}
-    std::function<T(U&)> fn;
-    T operator()(U& x) {
-        return fn(x);
-    };
-    T operator()(std::monostate) {
+template<typename N> struct PrimaryNode {
+    N* operator()(N& x) const {
+        return &x;
+    }
+    N* operator()(std::monostate) const {
         error(INTERNAL_ERROR, "Calling function on empty Term!");
-    };
+    }
 };
 
+static const Node& primary_node(const Primary& primary) {
+    return *std::visit(PrimaryNode<const Node>(), primary);
+}
+
 Term::Term(
     char prefix, char quantifier, const Primary& primary, const std::optional<Action>& error_action, Node* parent
 ):
-    Node("Term", parent), prefix(prefix), quantifier(quantifier), error_action(error_action), primary(primary) {}
+    Node(NK_TERM, parent), prefix(prefix), quantifier(quantifier), error_action(error_action), primary(primary) {}
 
-Term::Term(Parser& p, Node* parent): Node("Term", parent), prefix(0), quantifier(0) {
+Term::Term(Parser& p, Node* parent): Node(NK_TERM, parent), prefix(0), quantifier(0) {
     parse(p);
 }
 
@@ -72,11 +74,11 @@ void Term::parse(Parser& p) {
 }
 
 std::string Term::to_string(const Primary& x, const std::string& indent) const {
-    return std::visit(PrimaryVisitor<std::string>([&indent](const Node& x) { return x.to_string(indent); }), primary);
+    return primary_node(x).to_string(indent);
 }
 
 std::string Term::dump(const Primary& x, std::string indent) const {
-    return std::visit(PrimaryVisitor<std::string>([&indent](const Node& x) { return x.dump(indent); }), primary);
+    return primary_node(x).dump(indent);
 }
 
 std::string Term::to_string(std::string indent) const {
@@ -122,11 +124,11 @@ bool Term::is_multiline() const {
     if (!post_comment.empty()) {
         return true;
     }
-    return std::visit(PrimaryVisitor<bool>([](const Node& x) { return x.is_multiline(); }), primary);
+    return primary_node(primary).is_multiline();
 }
 
-size_t Term::hash() const {
-    size_t hash = std::visit(PrimaryVisitor<size_t>([](const Node& x) { return x.hash(); }), primary);
+size_t Term::compute_hash() const {
+    size_t hash = primary_node(primary).hash();
     hash = combine(hash, prefix);
     hash = combine(hash, quantifier);
     if (error_action) {
@@ -137,12 +139,16 @@ size_t Term::hash() const {
 
 Node* Term::operator[](int index) {
     if (index == 0) {
-        return std::visit(PrimaryVisitor<Node*, Node>([](Node& x) { return &x; }), primary);
+        return get_primary();
     } else {
         error(INTERNAL_ERROR, "index out of bounds!");
     }
 }
 
+Node* Term::get_primary() {
+    return std::visit(PrimaryNode<Node>(), primary);
+}
+
 long Term::size() const {
     return 1;
 }
@@ -184,18 +190,23 @@ bool Term::error_action_contains_any_capture() const {
 
 void Term::flip_negation() {
     prefix = is_negative() ? 0 : '!';
+    modified();
 }
 
 void Term::set_prefix(int new_prefix) {
     prefix = new_prefix;
+    modified();
 }
 
 void Term::set_quantifier(int new_quantifier) {
     quantifier = new_quantifier;
+    modified();
 }
 
 void Term::set_content(Primary content) {
     primary = content;
+    update_parents();
+    modified();
 }
 
 bool Term::same_prefix(const Term& t) {
@@ -208,18 +219,22 @@ bool Term::same_quantifier(const Term& t) {
 
 void Term::copy_prefix(const Term& other) {
     prefix = other.prefix;
+    modified();
 }
 
 void Term::copy_quantifier(const Term& other) {
     quantifier = other.quantifier;
+    modified();
 }
 
 void Term::copy_content(const Term& other) {
-    primary = other.primary;
+    // other can be a descendant of this term, so it must be copied before the current content is destroyed
+    set_content(other.primary);
 }
 
 void Term::remove_error_action() {
     error_action.reset();
+    modified();
 }
 
 bool operator==(const Term& a, const Term& b) {
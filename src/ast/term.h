@@ -23,6 +23,8 @@ class Term: public Node {
     Primary primary;
 
 public:
+    static const NodeKind KIND = NK_TERM;
+
     Term(char prefix, char quantifier, const Primary& primary, const std::optional<Action>& error_action, Node* parent);
     Term(Parser& p, Node* parent);
 
@@ -35,11 +37,13 @@ public:
     std::string dump(const Primary& x, std::string indent) const;
     virtual std::string dump(std::string indent = "") const override;
     virtual bool is_multiline() const override;
-    virtual size_t hash() const override;
+    virtual size_t compute_hash() const override;
 
     virtual Node* operator[](int index) override;
     virtual long size() const override;
 
+    Node* get_primary();
+
     template<class T> bool contains() const;
 
     template<class T> T& get();
@@ -67,6 +71,7 @@ public:
     void remove_error_action();
 
     friend bool operator==(const Term& a, const Term& b);
+    template<class F> friend bool for_each_child(Node& node, F&& fn);
     friend int optimize_repeating_terms(Term& t1, Term& t2);
     friend int optimize_double_quantifiers(const Term& outer, const Term& inner);
 };
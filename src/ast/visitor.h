@@ -0,0 +1,130 @@
+#pragma once
+#include "ast/grammar.h"
+#include "log.h"
+
+// Calls fn with the node cast to its concrete type, dispatching on the node kind instead of virtual calls.
+template<class F> decltype(auto) visit(Node& node, F&& fn) {
+    switch (node.get_kind()) {
+    case NK_ACTION: return fn(static_cast<Action&>(node));
+    case NK_ALTERNATION: return fn(static_cast<Alternation&>(node));
+    case NK_CAPTURE: return fn(static_cast<Capture&>(node));
+    case NK_CHARACTER_CLASS: return fn(static_cast<CharacterClass&>(node));
+    case NK_CODE: return fn(static_cast<Code&>(node));
+    case NK_DIRECTIVE: return fn(static_cast<Directive&>(node));
+    case NK_EXPAND: return fn(static_cast<Expand&>(node));
+    case NK_GRAMMAR: return fn(static_cast<Grammar&>(node));
+    case NK_GROUP: return fn(static_cast<Group&>(node));
+    case NK_MARKER: return fn(static_cast<Marker&>(node));
+    case NK_POSITION: return fn(static_cast<Position&>(node));
+    case NK_PREDICATE: return fn(static_cast<Predicate&>(node));
+    case NK_REFERENCE: return fn(static_cast<Reference&>(node));
+    case NK_RULE: return fn(static_cast<Rule&>(node));
+    case NK_SEQUENCE: return fn(static_cast<Sequence&>(node));
+    case NK_STRING: return fn(static_cast<String&>(node));
+    case NK_TERM: return fn(static_cast<Term&>(node));
+    }
+    error(INTERNAL_ERROR, "unsupported node kind!");
+}
+
+template<class F> bool for_each_child(Node& node, F&& fn) {
+    switch (node.get_kind()) {
+    case NK_GRAMMAR:
+        for (TopLevel& n: static_cast<Grammar&>(node).nodes) {
+            Node* child =
+                std::holds_alternative<Rule>(n) ? (Node*)&std::get<Rule>(n) : (Node*)std::get_if<Directive>(&n);
+            if (!child) {
+                error(INTERNAL_ERROR, "unsupported type!");
+            }
+            if (fn(*child)) {
+                return true;
+            }
+        }
+        return false;
+    case NK_RULE: return fn(static_cast<Rule&>(node).expression);
+    case NK_ALTERNATION:
+        for (Sequence& s: static_cast<Alternation&>(node).sequences) {
+            if (fn(s)) {
+                return true;
+            }
+        }
+        return false;
+    case NK_SEQUENCE:
+        for (Term& t: static_cast<Sequence&>(node).terms) {
+            if (fn(t)) {
+                return true;
+            }
+        }
+        return false;
+    case NK_TERM: return fn(*static_cast<Term&>(node).get_primary());
+    case NK_GROUP: return fn(*static_cast<Group&>(node).expression);
+    case NK_CAPTURE: return fn(*static_cast<Capture&>(node).expression);
+    default: return false;
+    }
+}
+
+// Pre-order traversal of the subtree rooted at node (including the node itself). Stops as soon
+// as fn returns true and returns true in that case.
+template<class F> bool walk(Node& node, F&& fn) {
+    if (fn(node)) {
+        return true;
+    }
+    return for_each_child(node, [&fn](Node& child) { return walk(child, fn); });
+}
+
+// Post-order variant of walk(), children are visited before their parent.
+template<class F> bool walk_post(Node& node, F&& fn) {
+    if (for_each_child(node, [&fn](Node& child) { return walk_post(child, fn); })) {
+        return true;
+    }
+    return fn(node);
+}
+
+// Appends all nodes of type U in the subtree (in document order) that satisfy the predicate.
+template<class U, class P> void collect(Node& node, std::vector<U*>& result, P&& predicate) {
+    walk(node, [&result, &predicate](Node& n) {
+        if (U* u = n.as<U>(); u && predicate(*u)) {
+            result.push_back(u);
+        }
+        return false;
+    });
+}
+
+template<class U, class P> std::vector<U*> collect(Node& node, P&& predicate) {
+    std::vector<U*> result;
+    collect<U>(node, result, predicate);
+    return result;
+}
+
+template<class U> std::vector<U*> collect(Node& node) {
+    return collect<U>(node, [](const U&) { return true; });
+}
+
+// Returns the first node of type U in the subtree that satisfies the predicate, or nullptr.
+template<class U, class P> U* find_first(Node& node, P&& predicate) {
+    U* found = nullptr;
+    walk(node, [&found, &predicate](Node& n) {
+        U* u = n.as<U>();
+        if (u && predicate(*u)) {
+            found = u;
+            return true;
+        }
+        return false;
+    });
+    return found;
+}
+
+template<class U> U* find_first(Node& node) {
+    return find_first<U>(node, [](const U&) { return true; });
+}
+
+template<class U> std::vector<U*> Node::find_children() {
+    return collect<U>(*this);
+}
+
+template<class U, class P> std::vector<U*> Node::find_children(P&& predicate) {
+    return collect<U>(*this, predicate);
+}
+
+template<class F> bool Node::map(F&& transform) {
+    return walk(*this, transform);
+}
@@ -0,0 +1,284 @@
+#include "cache.h"
+
+#include "config.h"
+#include "log.h"
+#include "utils.h"
+#include "version.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include <unistd.h>
+
+#if USE_EXPERIMENTAL_FILESYSTEM
+    #include <experimental/filesystem>
+namespace fs = std::experimental::filesystem;
+#else
+    #include <filesystem>
+namespace fs = std::filesystem;
+#endif
+
+static void evict(const std::string& dir, long max_size);
+
+// Writes the content to a private file first, so that other processes sharing the cache never see partial entries.
+static bool write_atomically(const std::string& path, const std::string& content) {
+    std::string tmp = path + ".tmp" + std::to_string(getpid()) + "_" +
+                      std::to_string(std::hash<std::thread::id> {}(std::this_thread::get_id()));
+    std::ofstream file(tmp);
+    file << content;
+    file.close();
+    std::error_code ec;
+    fs::rename(tmp, path, ec);
+    if (!file || ec) {
+        fs::remove(tmp, ec);
+        return false;
+    }
+    return true;
+}
+
+std::mutex ValidationCache::memory_lock;
+ValidationCache::MemoryEntries ValidationCache::memory;
+std::map<std::string, ValidationCache::MemoryEntries::iterator> ValidationCache::memory_index;
+long ValidationCache::memory_size = 0;
+
+ValidationCache::ValidationCache(const std::string& dir, long max_size, bool in_memory):
+    dir(dir), max_size(max_size), in_memory(in_memory) {
+    if (dir.empty()) {
+        return;
+    }
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    if (ec) {
+        error(IO_ERROR, "Failed to create cache directory '%s'", dir.c_str());
+    }
+}
+
+bool ValidationCache::enabled() const {
+    return in_memory || !dir.empty();
+}
+
+std::string ValidationCache::path(const std::string& key) const {
+    return (fs::path(dir) / key).string();
+}
+
+std::string ValidationCache::key(std::string_view grammar) const {
+    std::string options;
+    for (char c: Config::get_packcc_options()) {
+        options += c;
+    }
+    std::string prefix = "pegof " + pegof_version + "\npackcc " + pcc_version + "\noptions " + options + "\n";
+    return sha256(prefix + std::string(grammar));
+}
+
+bool ValidationCache::load_from_memory(const std::string& key, Entry& entry) const {
+    std::lock_guard<std::mutex> guard(memory_lock);
+    auto it = memory_index.find(key);
+    if (it == memory_index.end()) {
+        return false;
+    }
+    memory.splice(memory.begin(), memory, it->second);
+    entry = it->second->second;
+    log(3, "Validation cache hit in memory for %s", key.c_str());
+    return true;
+}
+
+void ValidationCache::store_in_memory(const std::string& key, const Entry& entry) const {
+    std::lock_guard<std::mutex> guard(memory_lock);
+    if (memory_index.count(key)) {
+        return;
+    }
+    memory.emplace_front(key, entry);
+    memory_index[key] = memory.begin();
+    memory_size += key.size() + entry.errors.size();
+    while (memory_size > max_size && memory.size() > 1) {
+        memory_size -= memory.back().first.size() + memory.back().second.errors.size();
+        memory_index.erase(memory.back().first);
+        memory.pop_back();
+    }
+}
+
+bool ValidationCache::load(const std::string& key, Entry& entry) const {
+    if (in_memory && load_from_memory(key, entry)) {
+        return true;
+    }
+    if (dir.empty()) {
+        log(3, "Validation cache miss for %s", key.c_str());
+        return false;
+    }
+    std::ifstream file(path(key));
+    if (!file) {
+        log(3, "Validation cache miss for %s", key.c_str());
+        return false;
+    }
+    int valid;
+    if (!(file >> valid >> entry.code_bytes >> entry.code_lines) || file.get() != '\n') {
+        warn("Ignoring corrupted validation cache entry %s", key.c_str());
+        return false;
+    }
+    std::stringstream errors;
+    errors << file.rdbuf();
+    entry.valid = valid;
+    entry.errors = errors.str();
+    file.close();
+
+    // mark the entry as recently used
+    std::error_code ec;
+    fs::last_write_time(path(key), fs::file_time_type::clock::now(), ec);
+    log(3, "Validation cache hit for %s", key.c_str());
+    if (in_memory) {
+        store_in_memory(key, entry);
+    }
+    return true;
+}
+
+void ValidationCache::store(const std::string& key, const Entry& entry) const {
+    if (in_memory) {
+        store_in_memory(key, entry);
+    }
+    if (dir.empty()) {
+        return;
+    }
+    std::stringstream content;
+    content << (entry.valid ? 1 : 0) << " " << entry.code_bytes << " " << entry.code_lines << "\n" << entry.errors;
+    if (!write_atomically(path(key), content.str())) {
+        warn("Failed to store validation cache entry %s", key.c_str());
+        return;
+    }
+    log(3, "Stored validation cache entry %s", key.c_str());
+    evict(dir, max_size);
+}
+
+static bool is_hash(std::string_view name) {
+    return name.size() == 64 && name.find_first_not_of("0123456789abcdef") == std::string_view::npos;
+}
+
+// Recognizes files created by the caches: validation entries, format entries and temporary files left behind
+// by interrupted writes. The directory may be shared with other files, those are never touched.
+static bool is_cache_file(std::string_view name) {
+    size_t tmp = name.find(".tmp");
+    if (tmp != std::string_view::npos) {
+        name = name.substr(0, tmp);
+    }
+    if (name.substr(0, 7) == "format_") {
+        name = name.substr(7);
+    }
+    return is_hash(name);
+}
+
+// Removes the least recently used entries of both caches when their total size exceeds the limit.
+static void evict(const std::string& dir, long max_size) {
+    std::vector<std::tuple<fs::file_time_type, uintmax_t, fs::path>> entries;
+    uintmax_t total = 0;
+    std::error_code ec;
+    for (const fs::directory_entry& item: fs::directory_iterator(dir, ec)) {
+        if (!fs::is_regular_file(item.status()) || !is_cache_file(item.path().filename().string())) {
+            continue;
+        }
+        uintmax_t size = fs::file_size(item.path(), ec);
+        fs::file_time_type time = fs::last_write_time(item.path(), ec);
+        if (ec) {
+            continue;
+        }
+        entries.emplace_back(time, size, item.path());
+        total += size;
+    }
+    if (total <= (uintmax_t)max_size) {
+        return;
+    }
+    std::sort(entries.begin(), entries.end());
+    for (const auto& [time, size, file]: entries) {
+        if (total <= (uintmax_t)max_size) {
+            break;
+        }
+        if (fs::remove(file, ec)) {
+            log(3, "Evicted validation cache entry %s", file.filename().string().c_str());
+            total -= size;
+        }
+    }
+}
+
+FormatCache::FormatCache(const std::string& dir, long max_size, const std::string& input):
+    dir(dir), max_size(max_size) {
+    if (dir.empty()) {
+        return;
+    }
+    std::string options = "quotes " + std::to_string(Config::settings().quotes) + "\nwrap " +
+                          std::to_string(Config::settings().wrap_limit) + "\nindent " + Config::get_indent() + "\n";
+    std::string path = input.empty() ? std::string("stdin") : canonical_path(input);
+    file = (fs::path(dir) / ("format_" + sha256("pegof " + pegof_version + "\n" + options + path))).string();
+
+    std::ifstream in(file, std::ios::binary);
+    if (!in) {
+        log(3, "No formatted rules cached for %s", path.c_str());
+        return;
+    }
+    // each rule is stored as lengths of its source and formatted text on a separate line, followed by the texts
+    size_t source_size, formatted_size;
+    while (in >> source_size >> formatted_size && in.get() == '\n') {
+        Entry entry = {std::string(source_size, '\0'), std::string(formatted_size, '\0')};
+        if (!in.read(entry.source.data(), source_size) || !in.read(entry.formatted.data(), formatted_size)) {
+            break;
+        }
+        previous.push_back(std::move(entry));
+    }
+    if (!in.eof()) {
+        warn("Ignoring corrupted format cache entry %s", file.c_str());
+        previous.clear();
+        return;
+    }
+    in.close();
+    for (const Entry& entry: previous) {
+        index[prefix(entry.source)].push_back(&entry);
+    }
+    std::error_code ec;
+    fs::last_write_time(file, fs::file_time_type::clock::now(), ec);
+    log(3, "Loaded %ld formatted rules of %s from cache", (long)previous.size(), path.c_str());
+}
+
+bool FormatCache::enabled() const {
+    return !dir.empty();
+}
+
+std::string_view FormatCache::prefix(std::string_view text) {
+    // the source starts with optional comments and "name <-", so this part is usually unique
+    size_t arrow = text.find("<-");
+    return arrow == std::string_view::npos ? text : text.substr(0, arrow + 2);
+}
+
+std::vector<const FormatCache::Entry*> FormatCache::find(std::string_view text) const {
+    std::vector<const Entry*> result;
+    auto it = index.find(prefix(text));
+    if (it == index.end()) {
+        return result;
+    }
+    for (const Entry* entry: it->second) {
+        if (text.substr(0, entry->source.size()) == entry->source) {
+            result.push_back(entry);
+        }
+    }
+    return result;
+}
+
+void FormatCache::add(std::string_view source, const std::string& formatted) {
+    current.push_back({std::string(source), formatted});
+}
+
+void FormatCache::save() const {
+    if (!enabled()) {
+        return;
+    }
+    std::string content;
+    for (const Entry& entry: current) {
+        content += std::to_string(entry.source.size()) + " " + std::to_string(entry.formatted.size()) + "\n";
+        content += entry.source + entry.formatted;
+    }
+    if (!write_atomically(file, content)) {
+        warn("Failed to store format cache entry %s", file.c_str());
+        return;
+    }
+    log(3, "Stored %ld formatted rules in %s", (long)current.size(), file.c_str());
+    evict(dir, max_size);
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Persistent cache of PackCC validation results. Each entry is stored in a separate file,
+// named by SHA-256 of everything that can change the result (grammar text, PackCC options
+// and versions of pegof and PackCC). Entries are touched when used and the least recently
+// used ones are removed when the total size of the directory exceeds the limit. Long running
+// processes can also keep the entries in memory, which is shared by all instances.
+class ValidationCache {
+public:
+    struct Entry {
+        bool valid;
+        long code_bytes;
+        long code_lines;
+        std::string errors;
+    };
+
+private:
+    using MemoryEntries = std::list<std::pair<std::string, Entry>>;
+
+    std::string dir;
+    long max_size;
+    bool in_memory;
+
+    static std::mutex memory_lock;
+    static MemoryEntries memory; // most recently used first
+    static std::map<std::string, MemoryEntries::iterator> memory_index;
+    static long memory_size;
+
+    std::string path(const std::string& key) const;
+    bool load_from_memory(const std::string& key, Entry& entry) const;
+    void store_in_memory(const std::string& key, const Entry& entry) const;
+
+public:
+    ValidationCache(const std::string& dir, long max_size, bool in_memory);
+
+    bool enabled() const;
+    std::string key(std::string_view grammar) const;
+    bool load(const std::string& key, Entry& entry) const;
+    void store(const std::string& key, const Entry& entry) const;
+};
+
+// Formatted rules from the previous run on the same input file, stored in the same directory as the validation
+// cache. Rules are identified by their exact source text (including the preceding whitespace and comments), so
+// that only the rules which changed since then have to be parsed and formatted again. Each input has a separate
+// entry, named by SHA-256 of its path, formatting options and version of pegof.
+class FormatCache {
+public:
+    struct Entry {
+        std::string source;
+        std::string formatted;
+    };
+
+private:
+    std::string dir;
+    long max_size;
+    std::string file;
+    std::vector<Entry> previous;
+    std::unordered_map<std::string_view, std::vector<const Entry*>> index; // keys point into previous
+    std::vector<Entry> current;
+
+    static std::string_view prefix(std::string_view text);
+
+public:
+    FormatCache(const std::string& dir, long max_size, const std::string& input);
+
+    bool enabled() const;
+    // Returns rules from the previous run whose source text is a prefix of given text.
+    std::vector<const Entry*> find(std::string_view text) const;
+    // Records the rule for the next run, all rules of the grammar must be added in order.
+    void add(std::string_view source, const std::string& formatted);
+    void save() const;
+};
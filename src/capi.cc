@@ -7,14 +7,19 @@
 extern "C" {
 
     FILE* dev_null(void) {
-        const std::string path = TempDir::get("null");
-        fclose(fopen(path.c_str(), "w"));
-        return fopen(path.c_str(), "r");
+        // always at EOF, so it can be shared by all callers and is opened only once, the initialization of the static
+        // variable is thread-safe and stdio locks the stream for each read, so parser threads can use it concurrently
+        static FILE* file = []() {
+            const std::string path = TempDir::get("null");
+            fclose(fopen(path.c_str(), "w"));
+            return fopen(path.c_str(), "r");
+        }();
+        return file;
     }
 
     void convert_parser(void* parser, char** input, size_t* len, unsigned long* pos) {
         Parser* p = (Parser*)parser;
-        *input = const_cast<char*>(p->input.c_str());
+        *input = const_cast<char*>(p->input.data());
         *len = p->input.size();
         *pos = p->pos;
     }
@@ -1,42 +1,198 @@
 #include "checker.h"
 
+#include "ast/visitor.h"
 #include "config.h"
 #include "log.h"
 #include "packcc_wrapper.h"
 #include "utils.h"
 
 #include <algorithm>
+#include <cerrno>
 #include <chrono>
+#include <cmath>
 #include <cstdarg>
+#include <cstdlib>
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <mutex>
+#include <numeric>
 #include <sstream>
+#include <tuple>
+#include <fcntl.h>
 #include <stdio.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
-std::stringstream packcc_errors;
+// Messages printed by PackCC to stderr. PackCC functions are also used by the parser, which may run on several threads
+// at once, so each thread collects its own messages.
+static thread_local std::stringstream packcc_errors;
 
 const std::string EMPTY = "";
 const int COL_WIDTH = 10;
 const int BUFFER_SIZE = 10240;
 
+// Critical values of Student's t-distribution for two-sided 95% confidence, indexed by degrees of freedom.
+static double t_critical(double df) {
+    static const double table[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                   2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                   2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    if (df < 1) {
+        return table[0];
+    } else if (df <= 30) {
+        return table[(int)df - 1];
+    } else if (df <= 60) {
+        return 2.000;
+    } else if (df <= 120) {
+        return 1.980;
+    }
+    return 1.960;
+}
+
+Sample::Sample(const std::vector<double>& values): values(values) {
+    std::sort(this->values.begin(), this->values.end());
+}
+
+long Sample::size() const {
+    return values.size();
+}
+
+double Sample::median() const {
+    if (values.empty()) {
+        return 0;
+    }
+    size_t n = values.size();
+    return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+double Sample::min() const {
+    return values.empty() ? 0 : values.front();
+}
+
+double Sample::mean() const {
+    return values.empty() ? 0 : std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+}
+
+double Sample::stddev() const {
+    if (values.size() < 2) {
+        return 0;
+    }
+    double m = mean();
+    double sum = 0;
+    for (double value: values) {
+        sum += (value - m) * (value - m);
+    }
+    return std::sqrt(sum / (values.size() - 1));
+}
+
+double Sample::confidence() const {
+    if (values.size() < 2) {
+        return 0;
+    }
+    return t_critical(values.size() - 1) * stddev() / std::sqrt(values.size());
+}
+
+bool Sample::differs(const Sample& other) const {
+    if (size() < 2 || other.size() < 2) {
+        return true;
+    }
+    double a = stddev() * stddev() / size();
+    double b = other.stddev() * other.stddev() / other.size();
+    if (a + b == 0) {
+        return mean() != other.mean();
+    }
+    double t = std::abs(mean() - other.mean()) / std::sqrt(a + b);
+    double df = (a + b) * (a + b) / (a * a / (size() - 1) + b * b / (other.size() - 1));
+    return t > t_critical(df);
+}
+
+static std::string format_number(double value) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.1f", value);
+    return buffer;
+}
+
+// Measured differences that are not statistically significant are marked with '~'.
+static std::string significance(const Sample& output, const Sample& input) {
+    return output.differs(input) ? EMPTY : "~";
+}
+
+static std::string sample_table(const std::string& name, const Sample& input, const Sample& output) {
+    if (input.size() < 2 || output.size() < 2) {
+        return EMPTY;
+    }
+    std::string result = "\n\n" + name + std::string(8 - name.size(), ' ');
+    for (const char* column: {"median", "min", "stddev", "95% CI"}) {
+        result += " | " + left_pad(column, COL_WIDTH);
+    }
+    result += "\n---------+------------+------------+------------+-----------";
+    for (const auto& [label, sample]: {std::make_pair("input   ", &input), std::make_pair("output  ", &output)}) {
+        result += std::string("\n") + label;
+        for (double value: {sample->median(), sample->min(), sample->stddev(), sample->confidence()}) {
+            result += " | " + left_pad(format_number(value), COL_WIDTH);
+        }
+    }
+    return result;
+}
+
+// Metrics shown in the stats table, only the first four also have the detailed statistics.
+static const std::pair<const char*, Sample Measurements::*> METRICS[] = {
+    {"duration", &Measurements::duration},
+    {"memory", &Measurements::memory},
+    {"user", &Measurements::user},
+    {"system", &Measurements::system},
+    {"min faults", &Measurements::minflt},
+    {"maj faults", &Measurements::majflt},
+    {"vol cs", &Measurements::nvcsw},
+    {"invol cs", &Measurements::nivcsw},
+};
+const int DETAILED_METRICS = 4;
+
 std::string Stats::compare(const Stats& s) const {
-    std::string result;
-#define COL(X) ((X > 0) ? (" | " + left_pad(#X, COL_WIDTH)) : EMPTY)
-    result += "        " + COL(lines) + COL(bytes) + COL(rules) + COL(terms) + COL(duration) + COL(memory) + "\n";
-#undef COL
-#define COL(X) ((X > 0) ? "-+-----------" : EMPTY)
-    result += "--------" + COL(lines) + COL(bytes) + COL(rules) + COL(terms) + COL(duration) + COL(memory) + "\n";
-#undef COL
-#define COL(X) ((X > 0) ? (" | " + left_pad(std::to_string(X), COL_WIDTH)) : EMPTY)
-    result +=
-        "input   " + COL(s.lines) + COL(s.bytes) + COL(s.rules) + COL(s.terms) + COL(s.duration) + COL(s.memory) + "\n";
-    result += "output  " + COL(lines) + COL(bytes) + COL(rules) + COL(terms) + COL(duration) + COL(memory) + "\n";
-#undef COL
-#define COL(X) ((X > 0) ? (" | " + left_pad(std::to_string(X * 100 / s.X) + "%", COL_WIDTH)) : EMPTY)
-    result += "output %" + COL(lines) + COL(bytes) + COL(rules) + COL(terms) + COL(duration) + COL(memory);
-#undef COL
+    struct Column {
+        std::string name;
+        long input;
+        long output;
+        std::string significance;
+    };
+    std::vector<Column> columns;
+    for (const auto& [name, input, output]: {std::make_tuple("lines", s.lines, lines),
+                                             std::make_tuple("bytes", s.bytes, bytes),
+                                             std::make_tuple("rules", s.rules, rules),
+                                             std::make_tuple("terms", s.terms, terms)}) {
+        if (output > 0) {
+            columns.push_back({name, input, output, EMPTY});
+        }
+    }
+    if (measured.duration.size() && s.measured.duration.size()) {
+        for (const auto& [name, metric]: METRICS) {
+            const Sample& input = s.measured.*metric;
+            const Sample& output = measured.*metric;
+            columns.push_back(
+                {name, std::lround(input.median()), std::lround(output.median()), significance(output, input)}
+            );
+        }
+    }
+
+    std::string header = "        ";
+    std::string separator = "--------";
+    std::string input_row = "input   ";
+    std::string output_row = "output  ";
+    std::string ratio_row = "output %";
+    for (const Column& col: columns) {
+        header += " | " + left_pad(col.name, COL_WIDTH);
+        separator += "-+-----------";
+        input_row += " | " + left_pad(std::to_string(col.input), COL_WIDTH);
+        output_row += " | " + left_pad(std::to_string(col.output), COL_WIDTH);
+        std::string ratio = col.input > 0 ? col.significance + std::to_string(col.output * 100 / col.input) + "%" : "-";
+        ratio_row += " | " + left_pad(ratio, COL_WIDTH);
+    }
+    std::string result = header + "\n" + separator + "\n" + input_row + "\n" + output_row + "\n" + ratio_row;
+    for (int i = 0; i < DETAILED_METRICS; i++) {
+        result += sample_table(METRICS[i].first, s.measured.*METRICS[i].second, measured.*METRICS[i].second);
+    }
     return result;
 }
 
@@ -44,9 +200,30 @@ Stats::operator bool() const {
     return lines >= 0;
 }
 
-Checker::Checker() {
+// Error messages contain path of the validated file, which is usually a random temporary path,
+// so it is replaced by a placeholder before storing the errors in the cache.
+const std::string INPUT_PLACEHOLDER = "\x01";
+
+static std::string replace_all(std::string str, const std::string& from, const std::string& to) {
+    if (from.empty()) {
+        return str;
+    }
+    for (size_t pos = str.find(from); pos != std::string::npos; pos = str.find(from, pos + to.size())) {
+        str.replace(pos, from.size(), to);
+    }
+    return str;
+}
+
+Checker::Checker():
+    code_bytes(0),
+    code_lines(0),
+    cache(
+        Config::settings().cache,
+        (long)Config::settings().cache_size * 1024 * 1024,
+        Config::settings().serve || Config::settings().watch
+    ) {
     output = TempDir::get("output");
-    skipValidation = Config::get<bool>("skip-validation") && Config::get().output_type != Config::OT_PACKCC;
+    skipValidation = Config::settings().skip_validation && Config::get().output_type != Config::OT_PACKCC;
 }
 
 Checker::~Checker() {}
@@ -55,13 +232,15 @@ void Checker::set_input_file(const std::string& input) {
     input_file = input;
 }
 
-bool Checker::call_packcc(const std::string& input, const std::string& output, std::string& errors) const {
+bool Checker::call_packcc(
+    const std::string& input, const std::string* content, const std::string& output, std::string& errors
+) const {
     if (skipValidation) {
         log(2, "Skipping validation due to --skip-validation");
         return true;
     }
 
-    log(2, "Processing %s with PackCC, storing output to %s.{h,c}", input.c_str(), output.c_str());
+    log(2, "Processing %s with PackCC, output %s.{h,c} is kept in memory", input.c_str(), output.c_str());
 
     // Call PackCC
     const std::set<char>& options = Config::get_packcc_options();
@@ -74,11 +253,35 @@ bool Checker::call_packcc(const std::string& input, const std::string& output, s
         pcc_array_add(&dirs, dir.c_str(), dir.size());
     }
 
-    bool result = pcc_process(input.c_str(), output.c_str(), &dirs, &opts);
+    // PackCC keeps its state in global variables, so only one grammar can be processed at a time
+    static std::mutex lock;
+    std::lock_guard<std::mutex> guard(lock);
+    // drop messages printed while parsing on this thread, those are not related to this grammar
+    packcc_errors.str("");
+    packcc_errors.clear();
+    pcc_buffer_t source_buffer;
+    pcc_buffer_t header_buffer;
+    bool result = pcc_process(
+        input.c_str(),
+        content ? content->data() : nullptr,
+        content ? content->size() : 0,
+        output.c_str(),
+        &dirs,
+        &opts,
+        &source_buffer,
+        &header_buffer
+    );
     pcc_array_term(&dirs);
+    source.assign(source_buffer.data ? source_buffer.data : "", source_buffer.len);
+    header.assign(header_buffer.data ? header_buffer.data : "", header_buffer.len);
+    code_bytes = source.size();
+    code_lines = std::count(source.begin(), source.end(), '\n');
+    free(source_buffer.data);
+    free(header_buffer.data);
 
-    // Collect errors
+    // Collect errors, the stream is reset while still holding the lock, so the next call starts empty
     errors = packcc_errors.str();
+    packcc_errors.str("");
     packcc_errors.clear();
 
     return result;
@@ -86,11 +289,11 @@ bool Checker::call_packcc(const std::string& input, const std::string& output, s
 
 bool Checker::packcc(const std::string& peg, const std::string& output) const {
     std::string err;
-    std::string input = TempDir::get("tmp.peg");
-    write_file(input, peg);
-    if (!call_packcc(input, output, err)) {
+    if (!call_packcc(TempDir::get("tmp.peg"), &peg, output, err)) {
         error(PARSING_ERROR, "Failed to parse grammar by packcc:\n%s", err.c_str());
     };
+    write_file(output + ".c", source);
+    write_file(output + ".h", header);
     return true;
 }
 
@@ -99,50 +302,103 @@ Stats Checker::stats(Grammar& g) const {
         log(2, "Skipping statistics calculation due to --skip-validation");
         return Stats();
     }
-    std::string code = read_file(output + ".c");
-    std::size_t lines = std::count(code.begin(), code.end(), '\n');
     int rules = g.find_children<Rule>().size();
     int terms = g.find_children<Term>().size();
-    int duration = 0;
-    int memory = 0;
-    benchmark(duration, memory);
-    log(2, "Code has %ld bytes and %ld lines", code.size(), lines);
+    Measurements measured;
+    benchmark(measured);
+    log(2, "Code has %ld bytes and %ld lines", code_bytes, code_lines);
     log(2, "Grammar has %d rules and %d terms", rules, terms);
-    return Stats(code.size(), lines, rules, terms, duration, memory);
+    return Stats(code_bytes, code_lines, rules, terms, measured);
 }
 
-bool Checker::validate(const std::string& input) const {
+bool Checker::validate(const std::string& input, const std::string* content, std::string_view text) const {
+    // Result of grammars with imports depends also on the imported files, so these are never cached. The benchmark
+    // needs the generated code, so it can't use cached results either.
+    bool cached = cache.enabled() && !skipValidation && text.find("%import") == std::string_view::npos;
+    std::string key = cached ? cache.key(text) : "";
+    ValidationCache::Entry entry;
+    if (cached && Config::settings().benchmark.empty() && cache.load(key, entry)) {
+        source.clear();
+        header.clear();
+        code_bytes = entry.code_bytes;
+        code_lines = entry.code_lines;
+        if (!entry.valid) {
+            std::string errors = replace_all(entry.errors, INPUT_PLACEHOLDER, input);
+            error(PARSING_ERROR, "Failed to parse grammar by packcc:\n%s", errors.c_str());
+        }
+        return true;
+    }
+
     std::string errors;
-    if (!call_packcc(input, output, errors)) {
+    bool valid = call_packcc(input, content, output, errors);
+    if (cached) {
+        cache.store(key, {valid, code_bytes, code_lines, replace_all(errors, input, INPUT_PLACEHOLDER)});
+    }
+    if (!valid) {
         error(PARSING_ERROR, "Failed to parse grammar by packcc:\n%s", errors.c_str());
     }
     return true;
 }
 
-bool Checker::validate(const std::string& filename, const std::string& content) const {
-    if (filename.empty()) {
-        return validate_string("stdin", content);
-    } else {
-        return validate_file(filename);
-    }
+bool Checker::validate(const std::string& filename, std::string_view content) const {
+    // the content is always passed from memory, the file does not even have to exist (e.g. in server mode),
+    // its path is only used in messages and to find imported files
+    std::string peg(content);
+    return validate(filename.empty() ? TempDir::get("stdin") : filename, &peg, peg);
 }
 
 bool Checker::validate_string(const std::string& filename, const std::string& peg) const {
-    std::string input = TempDir::get(filename);
-    write_file(input, peg);
-    return validate(input);
+    // the grammar is not written anywhere, the path only appears in messages
+    return validate(TempDir::get(filename), &peg, peg);
 }
 
 bool Checker::validate_file(const std::string& filename) const {
-    return validate(filename);
+    return validate(filename, nullptr, FileContent(filename).view());
+}
+
+// Runs the command in a child process with both stdout and stderr redirected to the given file. Returns exit code
+// of the command, resource usage of the child (including all its descendants) is stored in usage.
+static int run_measured(const std::string& cmd, const std::string& out, struct rusage& usage) {
+    pid_t pid = fork();
+    if (pid < 0) {
+        error(SCRIPT_ERROR, "Failed to start benchmark script: %s", strerror(errno));
+    }
+    if (pid == 0) {
+        int fd = open(out.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0) {
+            dup2(fd, STDOUT_FILENO);
+            dup2(fd, STDERR_FILENO);
+            close(fd);
+        }
+        execl("/bin/sh", "sh", "-c", cmd.c_str(), (char*)nullptr);
+        _exit(127);
+    }
+    int status;
+    while (wait4(pid, &status, 0, &usage) < 0) {
+        if (errno != EINTR) {
+            error(SCRIPT_ERROR, "Failed to wait for benchmark script: %s", strerror(errno));
+        }
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
 }
 
-void Checker::benchmark(int& duration, int& memory) const {
-    std::string script = Config::get<std::string>("benchmark");
+static double to_ms(const struct timeval& tv) {
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+void Checker::benchmark(Measurements& measured) const {
+    std::string script = Config::settings().benchmark;
     if (script.empty()) {
         return;
     }
 
+    write_file(output + ".c", source);
+    write_file(output + ".h", header);
+
+    // benchmarks of inputs processed in parallel would skew each other's measurements
+    static std::mutex lock;
+    std::lock_guard<std::mutex> guard(lock);
+
     int exit_code;
     log(1, "Setting up benchmark environment.");
     exit_code = system((script + " setup " + output).c_str());
@@ -151,19 +407,45 @@ void Checker::benchmark(int& duration, int& memory) const {
     }
 
     std::string out = TempDir::get("benchmark.out");
-    std::string time;
-    if (system("which /usr/bin/time 2> /dev/null > /dev/null") == 0) {
-        time = "/usr/bin/time -f \"\n%M\" ";
-    }
-    std::string cmd = time + script + " benchmark " + output + " > " + out + " 2>&1";
+    std::string cmd = "exec " + script + " benchmark " + output;
 
-    log(1, "Running benchmark.");
+    int warmup = Config::settings().benchmark_warmup;
+    int runs = Config::settings().benchmark_runs;
+    std::vector<double> values[std::size(METRICS)];
+    log(1, "Running benchmark (%d warm-up and %d measured runs).", warmup, runs);
     log(4, "Benchmark command: %s", cmd.c_str());
-    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
-    exit_code = system(cmd.c_str());
-    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
-    if (exit_code != 0) {
-        error(SCRIPT_ERROR, "%s\nBenchmark script failed! (exit_code=%d)", read_file(out).c_str(), exit_code);
+    for (int i = 0; i < warmup + runs; i++) {
+        struct rusage usage;
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        exit_code = run_measured(cmd, out, usage);
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        if (exit_code != 0) {
+            error(SCRIPT_ERROR, "%s\nBenchmark script failed! (exit_code=%d)", read_file(out).c_str(), exit_code);
+        }
+        if (i < warmup) {
+            continue;
+        }
+        // same order as in METRICS
+        double run[] = {
+            std::chrono::duration<double, std::milli>(end - begin).count(),
+            (double)usage.ru_maxrss,
+            to_ms(usage.ru_utime),
+            to_ms(usage.ru_stime),
+            (double)usage.ru_minflt,
+            (double)usage.ru_majflt,
+            (double)usage.ru_nvcsw,
+            (double)usage.ru_nivcsw,
+        };
+        for (size_t m = 0; m < std::size(METRICS); m++) {
+            values[m].push_back(run[m]);
+        }
+        log(2,
+            "Benchmark run %d took %.1f ms (%.1f ms user, %.1f ms system), peak memory %ld kB",
+            i - warmup + 1,
+            run[0],
+            run[2],
+            run[3],
+            usage.ru_maxrss);
     }
 
     log(1, "Tearing down benchmark environment.");
@@ -171,11 +453,9 @@ void Checker::benchmark(int& duration, int& memory) const {
     if (exit_code != 0) {
         error(SCRIPT_ERROR, "Benchmark teardown failed! (exit_code=%d)", exit_code);
     }
-    if (time.size()) {
-        std::vector<std::string> lines = split(read_file(out).c_str(), "\n");
-        memory = stoi(lines.back());
+    for (size_t m = 0; m < std::size(METRICS); m++) {
+        measured.*METRICS[m].second = Sample(values[m]);
     }
-    duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count();
 }
 
 extern "C" {
@@ -1,19 +1,52 @@
+#pragma once
 #include "ast/grammar.h"
+#include "cache.h"
 
 #include <string>
+#include <string_view>
+#include <vector>
+
+// Values of a single benchmark metric collected from repeated runs.
+class Sample {
+    std::vector<double> values;
+
+public:
+    Sample() {};
+    Sample(const std::vector<double>& values);
+    long size() const;
+    double median() const;
+    double min() const;
+    double mean() const;
+    double stddev() const;
+    // half-width of the 95% confidence interval of the mean
+    double confidence() const;
+    // Welch's t-test on 95% level, samples with less than two values are always considered different
+    bool differs(const Sample& other) const;
+};
+
+// Resource usage of the benchmark script, one sample per metric with values from all measured runs.
+struct Measurements {
+    Sample duration; // wall clock time in ms
+    Sample memory;   // peak resident set size in kB
+    Sample user;     // user CPU time in ms
+    Sample system;   // system CPU time in ms
+    Sample minflt;   // minor page faults
+    Sample majflt;   // major page faults
+    Sample nvcsw;    // voluntary context switches
+    Sample nivcsw;   // involuntary context switches
+};
 
 class Stats {
     int lines;
     int bytes;
     int rules;
     int terms;
-    int duration;
-    int memory;
+    Measurements measured;
 
 public:
-    Stats(int bytes, int lines, int rules, int terms, int duration, int memory):
-        lines(lines), bytes(bytes), rules(rules), terms(terms), duration(duration), memory(memory) {};
-    Stats(): lines(-1), bytes(-1), rules(-1), terms(-1), duration(-1), memory(-1) {};
+    Stats(int bytes, int lines, int rules, int terms, const Measurements& measured):
+        lines(lines), bytes(bytes), rules(rules), terms(terms), measured(measured) {};
+    Stats(): lines(-1), bytes(-1), rules(-1), terms(-1) {};
     std::string compare(const Stats& s) const;
     operator bool() const;
 };
@@ -22,9 +55,18 @@ class Checker {
     std::string input_file;
     std::string output;
     bool skipValidation;
-    bool call_packcc(const std::string& input, const std::string& output, std::string& errors) const;
-    bool validate(const std::string& input) const;
-    void benchmark(int& duration, int& memory) const;
+    // code generated by the last call to PackCC, it is only written to files when needed
+    mutable std::string source;
+    mutable std::string header;
+    // size of the generated code, known even if the code itself was not generated thanks to the cache
+    mutable long code_bytes;
+    mutable long code_lines;
+    ValidationCache cache;
+    bool call_packcc(
+        const std::string& input, const std::string* content, const std::string& output, std::string& errors
+    ) const;
+    bool validate(const std::string& input, const std::string* content, std::string_view text) const;
+    void benchmark(Measurements& measured) const;
 
 public:
     Checker();
@@ -34,6 +76,6 @@ public:
     bool packcc(const std::string& peg, const std::string& output) const;
     bool validate_string(const std::string& filename, const std::string& peg) const;
     bool validate_file(const std::string& filename) const;
-    bool validate(const std::string& filename, const std::string& content) const;
+    bool validate(const std::string& filename, std::string_view content) const;
     Stats stats(Grammar& g) const;
 };
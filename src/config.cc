@@ -5,6 +5,7 @@
 #include "version.h"
 
 #include <algorithm>
+#include <climits>
 #include <fstream>
 #include <iterator>
 #include <sstream>
@@ -13,6 +14,7 @@
 using namespace std::string_literals;
 
 Config* Config::instance = NULL;
+Config::Settings Config::values;
 static Config::Option UNKNOWN_OPTION(Config::OptionGroup::OG_BASIC, "", "", "", "", "");
 
 const std::map<std::string, Optimization> opt_mapping = {
@@ -138,14 +140,16 @@ void Config::usage_markdown() {
     log(0, "");
 }
 
+// Options that only print information stop the processing by throwing zero exit code, which is returned by main(),
+// so that applications using the library are not terminated.
 int Config::help() {
     usage("");
-    std::exit(0);
+    throw 0;
 }
 
 int Config::version() {
-    printf("Pegof version: %s\nPackCC version: %s\n", pegof_version.c_str(), pcc_version.c_str());
-    std::exit(0);
+    write_file("", log_format("Pegof version: %s\nPackCC version: %s\n", pegof_version.c_str(), pcc_version.c_str()));
+    throw 0;
 }
 
 int Config::set_input(const std::string& next) {
@@ -275,6 +279,7 @@ void Config::process_args(const std::vector<std::string>& arguments, const bool
                 i++;
             } else if (opt.value.type() == typeid(bool)) {
                 opt.value = !std::any_cast<bool>(opt.value);
+                update_log_level();
             } else if (opt.value.type() == typeid(std::string)) {
                 if (next.empty()) {
                     usage("Option '" + arg + "' requires an argument");
@@ -341,7 +346,44 @@ void Config::process_args(const std::vector<std::string>& arguments, const bool
     set_default<int>("wrap-limit");
     set_default<double>("inline-limit");
     set_default<std::string>("benchmark");
+    set_default<int>("benchmark-warmup");
+    set_default<int>("benchmark-runs");
     set_default<std::string>("debug-script");
+    set_default<int>("jobs");
+    set_default<std::string>("profile");
+    set_default<std::string>("cache");
+    set_default<int>("cache-size");
+    if (get<int>("jobs") < 1) {
+        usage("Number of jobs must be a positive number");
+    }
+    if (get<int>("benchmark-warmup") < 0) {
+        usage("Number of warm-up runs must not be negative");
+    }
+    if (get<int>("benchmark-runs") < 1) {
+        usage("Number of benchmark runs must be a positive number");
+    }
+    if (get<int>("cache-size") < 1) {
+        usage("Cache size must be a positive number");
+    }
+
+    values.timestamp = get<bool>("timestamp");
+    values.skip_validation = get<bool>("skip-validation");
+    values.cache = get<std::string>("cache");
+    values.cache_size = get<int>("cache-size");
+    values.quotes = get<QuoteType>("quotes");
+    values.wrap_limit = get<int>("wrap-limit");
+    values.inline_limit = get<double>("inline-limit");
+    values.no_follow = get<bool>("no-follow");
+    values.timeout = get<double>("timeout");
+    values.jobs = get<int>("jobs");
+    values.benchmark = get<std::string>("benchmark");
+    values.benchmark_warmup = get<int>("benchmark-warmup");
+    values.benchmark_runs = get<int>("benchmark-runs");
+    values.debug_script = get<std::string>("debug-script");
+    values.profile = get<std::string>("profile");
+    values.serve = serve;
+    values.socket = socket;
+    values.watch = get<bool>("watch");
 }
 
 void Config::post_process() {
@@ -363,6 +405,15 @@ void Config::post_process() {
     std::replace(inputs.begin(), inputs.end(), std::string("-"), std::string());
     std::replace(outputs.begin(), outputs.end(), std::string("-"), std::string());
 
+    if (Config::get<bool>("watch")) {
+        if (Config::get<bool>("inplace")) {
+            usage("Combining --watch and --inplace parameters is not allowed");
+        }
+        if (std::find(inputs.begin(), inputs.end(), std::string()) != inputs.end()) {
+            usage("Standard input can not be used with --watch");
+        }
+    }
+
     if (inputs.size() != outputs.size()) {
         usage("Number of inputs does not match number of outputs");
     }
@@ -427,10 +478,15 @@ std::vector<std::string> Config::get_all_imports_dirs(const std::string& input_f
 }
 
 bool Config::verbose(int level) {
-    return instance->verbosity >= level || get<bool>("debug");
+    return LogLevel::verbosity >= level;
 }
 
-int Config::parse_optimization_config(const std::string& param) {
+void Config::update_log_level() {
+    LogLevel::debug = get<bool>("debug");
+    LogLevel::verbosity = LogLevel::debug ? INT_MAX : verbosity;
+}
+
+int Config::find_optimizations(const std::string& param, std::string& unknown) {
     int result = O_NONE;
     std::vector<std::string> parts = split(param);
     for (const std::string& part: parts) {
@@ -438,12 +494,32 @@ int Config::parse_optimization_config(const std::string& param) {
         if (opt != opt_mapping.end()) {
             result |= opt->second;
         } else {
-            usage("Unrecognized optimization '" + part + "'!");
+            unknown = part;
+            return -1;
         }
     }
     return result;
 }
 
+int Config::parse_optimization_config(const std::string& param) {
+    std::string unknown;
+    int result = find_optimizations(param, unknown);
+    if (result < 0) {
+        usage("Unrecognized optimization '" + unknown + "'!");
+    }
+    return result;
+}
+
+void Config::set_request(OutputType output_type, const std::string& optimizations) {
+    std::string unknown;
+    int result = optimizations.empty() ? O_NONE : find_optimizations(optimizations, unknown);
+    if (result < 0) {
+        error(INVALID_ARG, "Unrecognized optimization '%s'!", unknown.c_str());
+    }
+    instance->output_type = output_type;
+    instance->optimizations = result;
+}
+
 int Config::parse_optimize(const std::string& param) {
     optimizations |= parse_optimization_config(param);
     return 1;
@@ -472,16 +548,20 @@ int Config::parse_header(const std::string& param) {
 }
 
 int Config::set_verbosity(const std::string& next, int) {
-    if (next.size() > 0 && std::all_of(next.begin(), next.end(), ::isdigit)) {
-        verbosity += std::stoi(next);
-        return 1;
-    } else {
-        verbosity++;
-        return 0;
-    }
+    bool has_level = next.size() > 0 && std::all_of(next.begin(), next.end(), ::isdigit);
+    verbosity += has_level ? std::stoi(next) : 1;
+    update_log_level();
+    return has_level ? 1 : 0;
+}
+
+int Config::set_serve(const std::string& next, int) {
+    serve = true;
+    socket = next;
+    return next.empty() ? 0 : 1;
 }
 
-Config::Config(int argc, char** argv): output_type(OT_UNSET), optimizations(O_NONE), verbosity(0), header(HM_UNSET) {
+Config::Config(int argc, char** argv):
+    output_type(OT_UNSET), optimizations(O_NONE), verbosity(0), header(HM_UNSET), serve(false) {
     instance = this;
 
     args = {
@@ -506,6 +586,27 @@ Config::Config(int argc, char** argv): output_type(OT_UNSET), optimizations(O_NO
             false,
             "Skip result validation (useful only for debugging purposes)"
         ),
+        Option(
+            OG_BASIC,
+            "C",
+            "cache",
+            std::string('\0', 1),
+            std::string(),
+            "Directory where results of validation are cached between runs\n"
+            "        Grammars that were already validated with the same options are not passed to PackCC again,\n"
+            "        when formatting without optimizations, only rules changed since the previous run are reformatted",
+            "DIR"
+        ),
+        Option(
+            OG_BASIC,
+            "Z",
+            "cache-size",
+            -1,
+            64,
+            "Maximum size of the validation cache in megabytes, least recently used results are removed\n"
+            "        Default is 64",
+            "N"
+        ),
         Option(
             OG_BASIC,
             "b",
@@ -515,6 +616,25 @@ Config::Config(int argc, char** argv): output_type(OT_UNSET), optimizations(O_NO
             "Benchmarking script, see documentation for details",
             "SCRIPT"
         ),
+        Option(
+            OG_BASIC,
+            "W",
+            "benchmark-warmup",
+            -1,
+            1,
+            "Number of benchmark runs executed before the measurement starts (default 1)",
+            "N"
+        ),
+        Option(
+            OG_BASIC,
+            "R",
+            "benchmark-runs",
+            -1,
+            5,
+            "Number of measured benchmark runs (default 5)\n"
+            "        Results are reported as median, differences that are not statistically significant are marked",
+            "N"
+        ),
         Option(
             OG_BASIC,
             "D",
@@ -524,6 +644,23 @@ Config::Config(int argc, char** argv): output_type(OT_UNSET), optimizations(O_NO
             "Debugging script, see documentation for details",
             "SCRIPT"
         ),
+        Option(
+            OG_BASIC,
+            "k",
+            "serve",
+            &Config::set_serve,
+            "Keep running and process requests in JSON format, one per line, see documentation for details\n"
+            "        Requests are read from standard input, or from Unix SOCKET if it is given",
+            "[SOCKET]"
+        ),
+        Option(
+            OG_BASIC,
+            "m",
+            "watch",
+            false,
+            false,
+            "Keep running and process the inputs again whenever they or any files imported from them change"
+        ),
         Option(OG_IO, "f", "format", OT_FORMAT, OT_UNSET, "Output formatted grammar (default)"),
         Option(OG_IO, "a", "ast", OT_AST, OT_UNSET, "Output abstract syntax tree representation"),
         Option(OG_IO, "g", "graph", OT_GRAPH, OT_UNSET, "Output description of the grammar in GraphViz format"),
@@ -548,7 +685,8 @@ Config::Config(int argc, char** argv): output_type(OT_UNSET), optimizations(O_NO
             "Path to file with PEG grammar, multiple paths can be given\n"
             "        Value \"-\" can be used to specify standard input\n"
             "        Mainly useful in config file\n"
-            "        If no file or --input is given, read standard input",
+            "        If no file or --input is given, read standard input\n"
+            "        If processing of some input fails, the other inputs are still processed",
             "FILE"
         ),
         Option(
@@ -639,13 +777,35 @@ Config::Config(int argc, char** argv): output_type(OT_UNSET), optimizations(O_NO
             "        Default is 0.0",
             "N"
         ),
+        Option(
+            OG_OPT,
+            "j",
+            "jobs",
+            -1,
+            1,
+            "Number of threads used to process multiple inputs, to load imported files and to run\n"
+            "        optimizations that process each rule separately\n"
+            "        The result does not depend on this value\n"
+            "        Default is 1",
+            "N"
+        ),
+        Option(
+            OG_OPT,
+            "r",
+            "profile",
+            std::string('\0', 1),
+            std::string(),
+            "Write time, number of calls, visited nodes, rewrites and grammar size change\n"
+            "        of each optimization to FILE in JSON format",
+            "FILE"
+        ),
     };
     std::vector<std::string> arguments(argv + 1, argv + argc);
     if (argc == 2 && strcmp(argv[1], "--usage-markdown") == 0) {
         usage_markdown();
-        std::exit(0);
+        throw 0;
     }
     process_args(arguments, false);
-    log(3, "Running pegof %s with arguments: %s", pegof_version.c_str(), join(arguments, " ").c_str());
     post_process();
+    log(3, "Running pegof %s with arguments: %s", pegof_version.c_str(), join(arguments, " ").c_str());
 }
@@ -80,8 +80,31 @@ struct Config {
             param(param) {}
     };
 
+    // Final values of the options, filled once all arguments are processed.
+    struct Settings {
+        bool timestamp;
+        bool skip_validation;
+        std::string cache;
+        int cache_size;
+        QuoteType quotes;
+        int wrap_limit;
+        double inline_limit;
+        bool no_follow;
+        double timeout;
+        int jobs;
+        std::string benchmark;
+        int benchmark_warmup;
+        int benchmark_runs;
+        std::string debug_script;
+        std::string profile;
+        bool serve;
+        std::string socket;
+        bool watch;
+    };
+
 private:
     static Config* instance;
+    static Settings values;
 
     std::vector<Option> args;
     int optimizations;
@@ -89,6 +112,8 @@ private:
     std::string indent;
     HeaderMode header;
     std::set<char> packcc_options;
+    bool serve;
+    std::string socket;
 
     void usage(const std::string& error);
     void usage_markdown();
@@ -103,11 +128,14 @@ private:
     int set_indent(const std::string& next);
     int set_packcc_options(const std::string& next);
     int load_config(const std::string& next);
+    static int find_optimizations(const std::string& param, std::string& unknown);
     int parse_optimization_config(const std::string& param);
     int parse_optimize(const std::string& param);
     int parse_header(const std::string& param);
     int parse_exclude(const std::string& param);
     int set_verbosity(const std::string& next, int);
+    int set_serve(const std::string& next, int);
+    void update_log_level();
 
     Option& find_option(const std::string& optionName);
 
@@ -126,10 +154,15 @@ private:
     }
 
 public:
+    // Looks up the option by name, use settings() instead in code that is called often.
     template<typename T> static const T get(std::string optionName) {
         return std::any_cast<T>(instance->find_option(optionName).value);
     }
 
+    static const Settings& settings() {
+        return values;
+    }
+
     static bool get(const Optimization& opt);
     static bool get(const HeaderMode& headerMode);
     static std::string get_opt_name(const Optimization& opt);
@@ -139,5 +172,8 @@ public:
     static std::vector<std::string> get_all_imports_dirs(const std::string& input_file);
     static bool verbose(int level);
 
+    // Replaces output type and optimizations given on command line, used by the server for each request.
+    static void set_request(OutputType output_type, const std::string& optimizations);
+
     Config(int argc, char** argv);
 };
@@ -0,0 +1,204 @@
+#include "json.h"
+
+#include "log.h"
+#include "utils.h"
+
+#include <cstdlib>
+
+class JsonParser {
+    std::string_view text;
+    size_t pos;
+
+    [[noreturn]] void fail(const char* message) {
+        error(INVALID_ARG, "Invalid JSON: %s at position %ld", message, (long)pos);
+    }
+
+    void skip_whitespace() {
+        while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r')) {
+            pos++;
+        }
+    }
+
+    void expect(char c) {
+        skip_whitespace();
+        if (pos >= text.size() || text[pos] != c) {
+            fail(log_format("expected '%c'", c).c_str());
+        }
+        pos++;
+    }
+
+    bool match(std::string_view word) {
+        if (text.substr(pos, word.size()) == word) {
+            pos += word.size();
+            return true;
+        }
+        return false;
+    }
+
+    unsigned parse_hex4() {
+        if (pos + 4 > text.size()) {
+            fail("truncated unicode escape");
+        }
+        unsigned result = 0;
+        for (int i = 0; i < 4; i++) {
+            char c = text[pos++];
+            result <<= 4;
+            if (c >= '0' && c <= '9') {
+                result |= c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                result |= c - 'a' + 10;
+            } else if (c >= 'A' && c <= 'F') {
+                result |= c - 'A' + 10;
+            } else {
+                fail("invalid unicode escape");
+            }
+        }
+        return result;
+    }
+
+    static void append_utf8(std::string& result, unsigned c) {
+        if (c < 0x80) {
+            result += (char)c;
+        } else if (c < 0x800) {
+            result += (char)(0xC0 | (c >> 6));
+            result += (char)(0x80 | (c & 0x3F));
+        } else if (c < 0x10000) {
+            result += (char)(0xE0 | (c >> 12));
+            result += (char)(0x80 | ((c >> 6) & 0x3F));
+            result += (char)(0x80 | (c & 0x3F));
+        } else {
+            result += (char)(0xF0 | (c >> 18));
+            result += (char)(0x80 | ((c >> 12) & 0x3F));
+            result += (char)(0x80 | ((c >> 6) & 0x3F));
+            result += (char)(0x80 | (c & 0x3F));
+        }
+    }
+
+    std::string parse_string() {
+        expect('"');
+        std::string result;
+        while (true) {
+            if (pos >= text.size()) {
+                fail("unterminated string");
+            }
+            char c = text[pos++];
+            if (c == '"') {
+                return result;
+            } else if (c != '\\') {
+                result += c;
+                continue;
+            }
+            if (pos >= text.size()) {
+                fail("unterminated string");
+            }
+            switch (text[pos++]) {
+            case '"': result += '"'; break;
+            case '\\': result += '\\'; break;
+            case '/': result += '/'; break;
+            case 'b': result += '\b'; break;
+            case 'f': result += '\f'; break;
+            case 'n': result += '\n'; break;
+            case 'r': result += '\r'; break;
+            case 't': result += '\t'; break;
+            case 'u': {
+                unsigned c = parse_hex4();
+                if (c >= 0xDC00 && c < 0xE000) {
+                    fail("invalid surrogate pair");
+                } else if (c >= 0xD800 && c < 0xDC00) {
+                    unsigned low = match("\\u") ? parse_hex4() : 0;
+                    if (low < 0xDC00 || low >= 0xE000) {
+                        fail("invalid surrogate pair");
+                    }
+                    c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                }
+                append_utf8(result, c);
+                break;
+            }
+            default: fail("invalid escape sequence");
+            }
+        }
+    }
+
+    JsonValue parse_value() {
+        skip_whitespace();
+        JsonValue value = {JsonValue::JT_NULL, "", "", 0, false};
+        size_t start = pos;
+        if (pos < text.size() && text[pos] == '"') {
+            value.type = JsonValue::JT_STRING;
+            value.string = parse_string();
+        } else if (match("true") || match("false")) {
+            value.type = JsonValue::JT_BOOL;
+            value.boolean = text[start] == 't';
+        } else if (match("null")) {
+            value.type = JsonValue::JT_NULL;
+        } else {
+            std::string number(text.substr(pos, 64));
+            char* end;
+            value.number = strtod(number.c_str(), &end);
+            if (end == number.c_str()) {
+                fail("unexpected value");
+            }
+            value.type = JsonValue::JT_NUMBER;
+            pos += end - number.c_str();
+        }
+        value.raw = text.substr(start, pos - start);
+        return value;
+    }
+
+public:
+    JsonParser(std::string_view text): text(text), pos(0) {}
+
+    JsonObject parse_object() {
+        JsonObject result;
+        expect('{');
+        skip_whitespace();
+        if (pos < text.size() && text[pos] == '}') {
+            pos++;
+        } else {
+            while (true) {
+                skip_whitespace();
+                std::string key = parse_string();
+                expect(':');
+                result[key] = parse_value();
+                skip_whitespace();
+                if (pos < text.size() && text[pos] == ',') {
+                    pos++;
+                    continue;
+                }
+                expect('}');
+                break;
+            }
+        }
+        skip_whitespace();
+        if (pos != text.size()) {
+            fail("unexpected text after the object");
+        }
+        return result;
+    }
+};
+
+JsonObject parse_json_object(std::string_view text) {
+    return JsonParser(text).parse_object();
+}
+
+std::string to_json_string(std::string_view str) {
+    std::string result = "\"";
+    for (char c: str) {
+        switch (c) {
+        case '"': result += "\\\""; break;
+        case '\\': result += "\\\\"; break;
+        case '\b': result += "\\b"; break;
+        case '\f': result += "\\f"; break;
+        case '\n': result += "\\n"; break;
+        case '\r': result += "\\r"; break;
+        case '\t': result += "\\t"; break;
+        default:
+            if ((unsigned char)c < 0x20) {
+                result += "\\u" + to_hex(c, 4);
+            } else {
+                result += c;
+            }
+        }
+    }
+    return result + "\"";
+}
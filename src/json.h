@@ -0,0 +1,23 @@
+#pragma once
+#include <map>
+#include <string>
+#include <string_view>
+
+// Minimal JSON support needed by the server mode: requests are flat objects with scalar values.
+struct JsonValue {
+    enum Type { JT_NULL, JT_BOOL, JT_NUMBER, JT_STRING };
+
+    Type type;
+    std::string raw;    // the value exactly as it appeared in the input
+    std::string string; // decoded value of strings
+    double number;
+    bool boolean;
+};
+
+using JsonObject = std::map<std::string, JsonValue>;
+
+// Parses single JSON object, nested objects and arrays are not supported.
+JsonObject parse_json_object(std::string_view text);
+
+// Returns quoted and escaped JSON string.
+std::string to_json_string(std::string_view str);
@@ -0,0 +1,88 @@
+#include "libpegof.h"
+
+#include "config.h"
+#include "log.h"
+#include "process.h"
+#include "utils.h"
+
+#include <memory>
+#include <mutex>
+
+static std::mutex lock;
+static std::unique_ptr<Config> config;
+
+static int configure(const std::vector<std::string>& options, std::string& log) {
+    // anything pegof would print to standard output (e.g. for --version) ends up in the log too
+    LogCapture capture(log);
+    OutputCapture output_capture(log);
+    std::vector<char*> argv = {const_cast<char*>("pegof")};
+    for (const std::string& option: options) {
+        argv.push_back(const_cast<char*>(option.c_str()));
+    }
+    try {
+        try {
+            config.reset(new Config(argv.size(), argv.data()));
+        } catch (int e) {
+            if (e != 0) {
+                throw;
+            }
+            // --help, --version and similar options successfully stop pegof, which would leave no configuration
+            error(INVALID_ARG, "Options that only print information (e.g. --help) can not be used in the library");
+        }
+        // grammars are passed in memory and each call returns once it is processed
+        const Config::Settings& settings = Config::settings();
+        bool default_io = config->inputs == std::vector<std::string>{""} && config->outputs == config->inputs;
+        if (!default_io || Config::get<bool>("inplace") || settings.serve || settings.watch) {
+            error(INVALID_ARG, "Inputs, outputs, --inplace, --serve and --watch can not be used in the library");
+        }
+        return 0;
+    } catch (int e) {
+        config.reset();
+        return e;
+    }
+}
+
+static int run(
+    Config::OutputType output_type,
+    const std::string& optimizations,
+    std::string_view grammar,
+    const std::string& path,
+    std::string& output,
+    std::string& log
+) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (!config) {
+        int result = configure({}, log);
+        if (result) {
+            return result;
+        }
+    }
+    return process_request(output_type, optimizations, path, grammar, output, log);
+}
+
+int pegof_configure(const std::vector<std::string>& options, std::string& log) {
+    std::lock_guard<std::mutex> guard(lock);
+    return configure(options, log);
+}
+
+int pegof_format(std::string_view grammar, const std::string& path, std::string& output, std::string& log) {
+    return run(Config::OT_FORMAT, "", grammar, path, output, log);
+}
+
+int pegof_optimize(
+    std::string_view grammar,
+    const std::string& path,
+    const std::string& optimizations,
+    std::string& output,
+    std::string& log
+) {
+    return run(Config::OT_FORMAT, optimizations, grammar, path, output, log);
+}
+
+int pegof_dump(std::string_view grammar, const std::string& path, std::string& output, std::string& log) {
+    return run(Config::OT_AST, "", grammar, path, output, log);
+}
+
+int pegof_dump_graph(std::string_view grammar, const std::string& path, std::string& output, std::string& log) {
+    return run(Config::OT_GRAPH, "", grammar, path, output, log);
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+
+// In-process interface of the libpegof library, for applications that need to process many grammars without
+// running the pegof executable. All functions work with grammars in memory and never throw, they return the exit
+// code that pegof would return (0 on success). All messages that pegof would print are returned in log.
+// The configuration is shared by the whole process, so the calls are serialized.
+
+// Sets options for all following calls, given in the same form as on the command line, e.g. {"--quotes", "single"}.
+// Without this call, the default options are used. Inputs, outputs, --inplace, --serve, --watch and options that
+// make pegof exit immediately (e.g. --help) are rejected with INVALID_ARG exit code.
+int pegof_configure(const std::vector<std::string>& options, std::string& log);
+
+// Parses the grammar and returns it formatted. Path is optional, it is only used in messages and to find imports.
+int pegof_format(std::string_view grammar, const std::string& path, std::string& output, std::string& log);
+
+// Same as pegof_format, but the grammar is optimized first, optimizations are given as for --optimize option.
+int pegof_optimize(
+    std::string_view grammar,
+    const std::string& path,
+    const std::string& optimizations,
+    std::string& output,
+    std::string& log
+);
+
+// Returns abstract syntax tree of the grammar, as with --ast option.
+int pegof_dump(std::string_view grammar, const std::string& path, std::string& output, std::string& log);
+
+// Returns description of the grammar in GraphViz format, as with --graph option.
+int pegof_dump_graph(std::string_view grammar, const std::string& path, std::string& output, std::string& log);
@@ -1,8 +1,14 @@
 #include "log.h"
 
 #include <chrono>
+#include <mutex>
 #include <string>
 
+static thread_local std::string* log_capture = nullptr;
+
+int LogLevel::verbosity = 0;
+bool LogLevel::debug = false;
+
 DebugIndent::DebugIndent() {
     DebugIndent::inc();
 }
@@ -12,7 +18,7 @@ DebugIndent::~DebugIndent() {
 }
 
 int DebugIndent::indent(int increment) {
-    static int indent = 0;
+    static thread_local int indent = 0;
     indent += increment;
     return indent;
 }
@@ -25,18 +31,47 @@ void DebugIndent::dec() {
     indent(-1);
 }
 
-void DebugIndent::print() {
-    fprintf(stderr, "%*s", indent() * 2, "");
+std::string DebugIndent::get() {
+    return std::string(indent() * 2, ' ');
+}
+
+LogCapture::LogCapture(std::string& buffer): previous(log_capture) {
+    log_capture = &buffer;
+}
+
+LogCapture::~LogCapture() {
+    log_capture = previous;
+}
+
+std::string get_timestamp() {
+    if (!Config::settings().timestamp) {
+        return "";
+    }
+    std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
+    int micros = (std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()) % 1000000).count();
+    time_t time = std::chrono::system_clock::to_time_t(now);
+    char timestamp[20];
+    std::tm tm;
+    strftime(timestamp, 20, "%F %T", localtime_r(&time, &tm));
+    return log_format("%s.%06d ", timestamp, micros);
 }
 
-void print_timestamp() {
-    static bool timestamp_config = Config::get<bool>("timestamp");
-    if (timestamp_config) {
-        std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
-        int micros = (std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()) % 1000000).count();
-        time_t time = std::chrono::system_clock::to_time_t(now);
-        char timestamp[20];
-        std::strftime(timestamp, 20, "%F %T", std::localtime(&time));
-        fprintf(stderr, "%s.%06d ", timestamp, micros);
+static void write_raw(const std::string& text) {
+    if (log_capture) {
+        *log_capture += text;
+        return;
     }
+    static std::mutex lock;
+    std::lock_guard<std::mutex> guard(lock);
+    fputs(text.c_str(), stderr);
+}
+
+void LogCapture::replay(const std::string& buffer) {
+    if (!buffer.empty()) {
+        write_raw(buffer);
+    }
+}
+
+void write_log(const std::string& message) {
+    write_raw(message + "\n");
 }
@@ -2,6 +2,7 @@
 #include "config.h"
 
 #include <stdio.h>
+#include <string>
 
 class DebugIndent {
     static int indent(int increment = 0);
@@ -11,45 +12,68 @@ public:
     ~DebugIndent();
     static void inc();
     static void dec();
-    static void print();
+    static std::string get();
+};
+
+// While this object exists, messages logged by the current thread are appended to the buffer instead
+// of being printed. This allows to print output of tasks running in parallel in a deterministic order.
+class LogCapture {
+    std::string* previous;
+
+public:
+    LogCapture(std::string& buffer);
+    ~LogCapture();
+
+    // Prints messages collected earlier.
+    static void replay(const std::string& buffer);
+};
+
+// Logging configuration, resolved by Config whenever the relevant options change,
+// so that deciding whether to print a message costs a single comparison.
+struct LogLevel {
+    static int verbosity;
+    static bool debug;
 };
 
 enum ExitCode { INVALID_ARG = 1, IO_ERROR = 2, SCRIPT_ERROR = 3, INTERNAL_ERROR = 5, PARSING_ERROR = 10 };
 
-void print_timestamp();
+std::string get_timestamp();
+void write_log(const std::string& message);
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wformat-security"
 
-template<typename... T> void debug(const char* format, T... args) {
-    if (Config::get<bool>("debug")) {
-        print_timestamp();
-        DebugIndent::print();
-        fprintf(stderr, format, args...);
-        fprintf(stderr, "\n");
-    }
+template<typename... T> std::string log_format(const char* format, T... args) {
+    int size = snprintf(nullptr, 0, format, args...);
+    std::string result(size, '\0');
+    snprintf(result.data(), size + 1, format, args...);
+    return result;
 }
 
+template<typename... T> void debug_message(const char* format, T... args) {
+    write_log(get_timestamp() + DebugIndent::get() + log_format(format, args...));
+}
+
+// Arguments of debug() are only evaluated when debugging is enabled, so they can be arbitrarily expensive.
+// Building with -DDISABLE_DEBUG_LOG removes debug messages from the binary entirely.
+#if DISABLE_DEBUG_LOG
+    #define debug(...) ((void)0)
+#else
+    #define debug(...) (LogLevel::debug ? debug_message(__VA_ARGS__) : (void)0)
+#endif
+
 template<typename... T> void log(int level, const char* format, T... args) {
-    if (Config::verbose(level)) {
-        print_timestamp();
-        fprintf(stderr, format, args...);
-        fprintf(stderr, "\n");
+    if (LogLevel::verbosity >= level) {
+        write_log(get_timestamp() + log_format(format, args...));
     }
 }
 
 template<typename... T> void warn(const char* format, T... args) {
-    print_timestamp();
-    fprintf(stderr, "WARNING: ");
-    fprintf(stderr, format, args...);
-    fprintf(stderr, "\n");
+    write_log(get_timestamp() + "WARNING: " + log_format(format, args...));
 }
 
 template<typename... T> void error [[noreturn]] (ExitCode exit_code, const char* format, T... args) {
-    print_timestamp();
-    fprintf(stderr, "ERROR: ");
-    fprintf(stderr, format, args...);
-    fprintf(stderr, "\n");
+    write_log(get_timestamp() + "ERROR: " + log_format(format, args...));
     throw (int)exit_code;
 }
 
@@ -1,111 +1,36 @@
-#include "ast/grammar.h"
-#include "checker.h"
 #include "config.h"
 #include "log.h"
-#include "optimizer.h"
-#include "parser.h"
+#include "process.h"
+#include "server.h"
 #include "utils.h"
 #include "version.h"
+#include "watch.h"
 
-Grammar parse(const std::string& input, const Checker& checker) {
-    std::string content = read_file(input);
-
-    log(1, "Validating input grammar ...");
-    checker.validate(input, content);
-
-    log(1, "Parsing grammar ...");
-    Parser peg(content);
-    Grammar g(peg, input);
-    if (!g) {
-        error(PARSING_ERROR, "Failed to parse grammar!");
-    }
-    return g;
-}
-
-void process_with_packcc(const Checker& checker, const std::string& grammar, const std::string& output) {
-    if (output.empty()) {
-        error(INVALID_ARG, "Option -p/--packcc requires output to file, use -o/--output!");
-    }
-    log(1, "Processing with PackCC ...");
-    if (!checker.packcc(grammar, output)) {
-        throw 10;
-    }
-    log(1, "Parser was generated in %s.{h,c}", output.c_str());
-};
-
-void process(
-    const Config::OutputType& output_type, const std::string& input, const std::string& output, const Checker& checker
-) {
-    log(1,
-        "Processing file %s, storing output to %s ...",
-        input.empty() ? "stdin" : input.c_str(),
-        output.empty() ? "stdout" : output.c_str());
-
-    if (output_type == Config::OT_PACKCC && !Config::get(O_ALL)) {
-        // Fast path if we're called just to produce code without any optimizations - no need to parse the grammar
-        process_with_packcc(checker, read_file(input), output);
-        return;
-    }
-
-    Grammar g = parse(input, checker);
-    g.update_parents();
-    Stats in_stats = checker.stats(g);
-
-    if (Config::get(O_ALL)) {
-        log(1, "Optimizing grammar ...");
-        Optimizer opt(g);
-        g = opt.optimize();
-        g.update_parents();
-    }
-
-    std::string result;
-    if (output_type != Config::OT_AST) {
-        log(1, "Validating formatted grammar ...");
-        result = g.to_string();
-        checker.validate_string("formatted.peg", result);
-    }
-
-    if (in_stats && Config::get(O_ALL) && (Config::verbose(1) || !Config::get<std::string>("benchmark").empty())) {
-        log(1, "Computing stats ...");
-        Stats out_stats = checker.stats(g);
-        log(0, "%s", out_stats.compare(in_stats).c_str());
-    }
-
-    switch (output_type) {
-    case Config::OT_FORMAT:
-        log(1, "Writing formatted output ...");
-        if (Config::get(HM_ALWAYS) || (Config::get(HM_AUTO) && Config::get(O_ALL))) {
-            result =
-                "# Generated by pegof " + pegof_version + " from " + input + "\n# Do not edit manually\n\n" + result;
-        }
-        write_file(output, result);
-        break;
-    case Config::OT_AST:
-        log(1, "Writing AST ...");
-        write_file(output, g.dump());
-        break;
-    case Config::OT_GRAPH:
-        log(1, "Writing graph ...");
-        write_file(output, g.dump_graph(input + (Config::get(O_ALL) ? " (optimized)" : "")));
-        break;
-    case Config::OT_PACKCC: process_with_packcc(checker, result, output); break;
-    case Config::OT_UNSET: error(INTERNAL_ERROR, "output type not set!");
-    }
-}
+#include <numeric>
 
 int main(int argc, char** argv) {
     try {
         Config conf(argc, argv);
         debug("Pegof version: %s", pegof_version.c_str());
         debug("PackCC version: %s", pcc_version.c_str());
-        Checker checker;
+        // files can be rewritten at any time while serving or watching, see FileContent
+        FileContent::use_mapping = !Config::settings().serve && !Config::settings().watch;
+        if (Config::settings().serve) {
+            return serve(Config::settings().socket);
+        }
+
+        if (Config::settings().watch) {
+            return watch(conf);
+        }
 
-        for (int i = 0; i < conf.inputs.size(); i++) {
-            const std::string& input = conf.inputs[i];
-            const std::string& output = conf.outputs[i];
-            checker.set_input_file(input);
-            process(conf.output_type, input, output, checker);
+        std::vector<std::string> profiles(conf.inputs.size());
+        std::vector<int> all(conf.inputs.size());
+        std::iota(all.begin(), all.end(), 0);
+        int result = process_inputs(conf, all, profiles);
+        if (result) {
+            return result;
         }
+        write_profile(profiles);
         return 0;
     } catch (int e) {
         return e;
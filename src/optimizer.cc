@@ -1,29 +1,163 @@
 #include "optimizer.h"
 
+#include "ast/visitor.h"
 #include "config.h"
+#include "json.h"
 #include "log.h"
 #include "utils.h"
 
+#include <algorithm>
 #include <chrono>
 #include <errno.h>
+#include <exception>
 #include <math.h>
+#include <optional>
 #include <set>
 #include <string.h>
 #include <sys/wait.h>
 
-Optimizer::Optimizer(Grammar& g): g(g) {}
+Optimizer::Optimizer(Grammar& g):
+    g(g),
+    pool(Config::settings().jobs),
+    current(O_NONE),
+    rule_count(0),
+    runs(0),
+    skipped_runs(0),
+    scans(0),
+    skipped_scans(0),
+    profiling(!Config::settings().profile.empty()),
+    visited(0) {}
+
+static long count_nodes(Node& node) {
+    long count = 0;
+    walk(node, [&count](Node&) {
+        count++;
+        return false;
+    });
+    return count;
+}
+
+static long count_nodes(const std::vector<Rule*>& rules) {
+    long count = 0;
+    for (Rule* rule: rules) {
+        count += count_nodes(*rule);
+    }
+    return count;
+}
+
+// warnings of the rule processed by apply() in the current thread
+static thread_local std::vector<std::string>* rule_warnings = nullptr;
 
 void Optimizer::warn_once(const std::string& warning) {
-    static std::set<std::string> warnings;
-    if (warnings.count(warning) == 0) {
+    if (rule_warnings) {
+        rule_warnings->push_back(warning);
+    } else {
         warn("%s", warning.c_str());
-        warnings.insert(warning);
     }
 }
 
-int Optimizer::apply(const std::function<bool(Node&, int&)>& transform) {
+void Optimizer::touch(const Rule& rule) {
+    for (auto& [optimization, rules]: worklist) {
+        rules.insert(rule.get_name());
+    }
+}
+
+void Optimizer::requeue(const std::string& name) {
+    for (Optimization optimization: {O_INLINE, O_SAME_RULES}) {
+        auto it = worklist.find(optimization);
+        if (it != worklist.end()) {
+            it->second.insert(name);
+        }
+    }
+}
+
+void Optimizer::forget(Rule& rule) {
+    for (auto& [optimization, rules]: worklist) {
+        rules.erase(rule.get_name());
+    }
+    // rules referenced from the removed rule now have fewer references, so their inlining score changed
+    for (Reference* ref: rule.find_children<Reference>()) {
+        if (ref->get_name() != rule.get_name()) {
+            requeue(ref->get_name());
+        }
+    }
+    rule_count--;
+}
+
+template<class F> int Optimizer::apply(F&& transform) {
+    std::set<std::string>& pending = worklist[current];
+    std::vector<Rule*> rules;
+    for (int i = 0; i < g.size(); i++) {
+        Rule* rule = g[i]->as<Rule>();
+        if (!rule) {
+            continue;
+        }
+        if (!pending.erase(rule->get_name())) {
+            // this rule didn't change since the last time this optimization checked it
+            skipped_scans++;
+            continue;
+        }
+        scans++;
+        rules.push_back(rule);
+    }
+
+    // The transforms only change the rule they were called on, so the rules can be processed in parallel.
+    // Results and log messages are collected per rule and then processed in the grammar order, so the
+    // outcome is the same for any number of jobs.
+    std::vector<int> counts(rules.size(), 0);
+    std::vector<long> visits(rules.size(), 0);
+    std::vector<std::string> logs(rules.size());
+    std::vector<std::vector<std::string>> warning_lists(rules.size());
+    std::vector<std::exception_ptr> failures(rules.size());
+    bool parallel = pool.size() > 1 && rules.size() > 1;
+    pool.run(rules.size(), [&](int i) {
+        Arena::Scope scope(g.get_arena());
+        std::optional<LogCapture> capture;
+        if (parallel) {
+            capture.emplace(logs[i]);
+        }
+        rule_warnings = &warning_lists[i];
+        try {
+            // The transform stops the walk after each rewrite that moved nodes around. Then the rule is
+            // walked again from the start, until there is nothing left to rewrite in it.
+            int& optimized = counts[i];
+            long& visited = visits[i];
+            int last;
+            do {
+                last = optimized;
+            } while (walk(*rules[i],
+                          [&optimized, &visited, &transform](Node& node) {
+                              visited++;
+                              return transform(node, optimized);
+                          })
+                     && optimized > last);
+        } catch (...) {
+            rule_warnings = nullptr;
+            if (!parallel) {
+                throw;
+            }
+            failures[i] = std::current_exception();
+        }
+        rule_warnings = nullptr;
+    });
+
     int optimized = 0;
-    g.map([&optimized, transform](Node& node) mutable -> bool { return transform(node, optimized); });
+    for (int i = 0; i < rules.size(); i++) {
+        LogCapture::replay(logs[i]);
+        for (const std::string& warning: warning_lists[i]) {
+            if (warnings.insert(warning).second) {
+                warn("%s", warning.c_str());
+            }
+        }
+        if (failures[i]) {
+            std::rethrow_exception(failures[i]);
+        }
+        visited += visits[i];
+        if (counts[i]) {
+            touch(*rules[i]);
+            optimized += counts[i];
+        }
+    }
     return optimized;
 }
 
@@ -59,7 +193,6 @@ int Optimizer::concat_strings() {
                             prev_str->to_c_string().c_str());
                         str.append(*prev_str);
                         s->erase(prev_term);
-                        s->update_parents();
                         optimized++;
                     }
                 }
@@ -70,7 +203,7 @@ int Optimizer::concat_strings() {
                 prev_term = nullptr;
             }
         }
-        return optimized > 0;
+        return false; // only the children of this node were changed and they were not visited yet
     });
 }
 
@@ -101,7 +234,6 @@ int Optimizer::concat_character_classes() {
                             log(1, "Merging character classes: %s + %s", STR(t), STR(*prev_term));
                             cc1.merge(cc2);
                             a->erase(i + 1);
-                            a->update_parents();
                             optimized++;
                         }
                     }
@@ -111,7 +243,7 @@ int Optimizer::concat_character_classes() {
                 prev_term = nullptr;
             }
         }
-        return optimized > 0;
+        return false; // only the children of this node were changed and they were not visited yet
     });
 }
 
@@ -129,7 +261,6 @@ int optimize_repeating_terms(Term& t1, Term& t2) {
         if (a->size() > 1) {
             log(1, "Removing %s from %s", STR(*s), STR(*a));
             a->erase(s);
-            a->update_parents();
             return 0;
         } else {
             Optimizer::warn_once("Detected sequence that will never match: " + t1.to_string() + " " + t2.to_string());
@@ -138,14 +269,14 @@ int optimize_repeating_terms(Term& t1, Term& t2) {
     } else if (t1.quantifier == '?') {
         switch (t2.quantifier) {
         case '*': return 1; // delete t1
-        case '+': t1.quantifier = 0; return 0;
+        case '+': t1.set_quantifier(0); return 0;
         case 0:
-            t1.quantifier = 0;
-            t2.quantifier = '?';
+            t1.set_quantifier(0);
+            t2.set_quantifier('?');
             return 0;
         }
     } else if (t1.quantifier == 0 && t2.quantifier == '*') {
-        t1.quantifier = '+';
+        t1.set_quantifier('+');
         return 2; // delete t2
     }
     return -1;
@@ -170,7 +301,6 @@ int Optimizer::simplify_repeats() {
             case 1: s->erase(i - 1); break;
             case 2: s->erase(i); break;
             }
-            s->update_parents();
             optimized++;
             return true;
         }
@@ -235,18 +365,15 @@ int Optimizer::double_negations() {
         if (!t || !t->contains<Group>() || !t->is_negative()) {
             return false;
         }
-        Group group = t->get<Group>();
-        if (!group.has_single_term()) {
+        const Group& group = t->get<Group>();
+        if (!group.has_single_term() || !group.get_first_term().is_negative()) {
             return false;
         }
         Term inner_term = group.get_first_term();
-        if (!inner_term.is_negative()) {
-            return false;
-        }
         log(1, "Optimizing double negation: %s", STR(*t));
         *t = inner_term;
-        t->set_prefix(0);
         t->update_parents();
+        t->set_prefix(0);
         optimized++;
         return true;
     });
@@ -266,18 +393,18 @@ int Optimizer::double_quantifications() {
         if (!t || !t->contains<Group>() || !t->is_quantified()) {
             return false;
         }
-        Group group = t->get<Group>();
+        const Group& group = t->get<Group>();
         if (!group.has_single_term()) {
             return false;
         }
-        Term inner_term = group.get_first_term();
+        const Term& inner_term = group.get_first_term();
         if (!inner_term.is_quantified() || inner_term.is_prefixed()) {
             return false;
         }
         log(1, "Optimizing double quantification: %s", STR(*t));
+        int quantifier = optimize_double_quantifiers(*t, inner_term);
         t->copy_content(inner_term);
-        t->set_quantifier(optimize_double_quantifiers(*t, inner_term));
-        t->update_parents();
+        t->set_quantifier(quantifier);
         optimized++;
         return true;
     });
@@ -292,16 +419,15 @@ int Optimizer::remove_unnecessary_groups() {
                 if (!s.has_single_term()) {
                     continue;
                 }
-                Term term = s.get_first_term();
+                Term& term = s.get_first_term();
                 if (!term.is_simple() || !term.contains<Group>()) {
                     continue;
                 }
                 // A / (B / C) / D -> A / B / C / D
                 log(1, "Removing grouping from '%s'", STR(term));
-                Group group = term.get<Group>();
+                Alternation inner = term.get<Group>().convert_to_alternation();
                 a->erase(pos);
-                a->insert(pos, group.convert_to_alternation());
-                a->update_parents();
+                a->insert(pos, inner);
                 optimized++;
                 return true;
             }
@@ -310,7 +436,7 @@ int Optimizer::remove_unnecessary_groups() {
         if (!t || !t->contains<Group>()) {
             return false;
         }
-        Group group = t->get<Group>();
+        const Group& group = t->get<Group>();
         if (!group.has_single_sequence()) {
             return false;
         }
@@ -325,16 +451,15 @@ int Optimizer::remove_unnecessary_groups() {
                     break;
                 }
             }
+            Sequence inner = group.get_first_sequence();
             s->erase(pos);
-            s->insert(pos, group.get_first_sequence());
-            s->update_parents();
+            s->insert(pos, inner);
             optimized++;
             return true;
         } else if (group.has_single_term() && first_term.is_simple()) {
             // A (B)* C -> A B* C
             log(1, "Removing grouping from %s", STR(*t));
             t->copy_content(first_term);
-            t->update_parents();
             optimized++;
             return true;
         }
@@ -390,7 +515,10 @@ int Optimizer::unused_captures() {
             log(1, "Removing unused capture '%s' in rule %s.", STR(*captures[i]), rule->c_str());
             Term* parent = captures[i]->get_parent<Term>();
             parent->set_content(captures[i]->convert_to_group());
-            parent->update_parents();
+            // nodes inside of the capture were replaced by copies
+            expands = rule->find_children<Expand>();
+            actions = rule->find_children<Action>();
+            predicates = rule->find_children<Predicate>();
             for (int j = 0; j < expands.size(); j++) {
                 if (*expands[j] <= i) {
                     continue;
@@ -426,7 +554,6 @@ int Optimizer::empty_actions() {
             Sequence* s = t->get_parent<Sequence>();
             log(1, "Removing empty action in '%s'.", STR(*s));
             s->erase(t);
-            s->update_parents();
             optimized++;
             return true;
         }
@@ -442,8 +569,11 @@ int Optimizer::empty_actions() {
 }
 
 int Optimizer::repeated_sequence() {
-    std::vector<Alternation*> alternations = g.find_children<Alternation>();
-    for (Alternation* alternation: alternations) {
+    return apply([](Node& node, int& optimized) -> bool {
+        Alternation* alternation = node.as<Alternation>();
+        if (!alternation) {
+            return false;
+        }
         std::map<size_t, Sequence*> hashes;
         for (int i = 0; i < alternation->size(); i++) {
             Sequence* sequence = (Sequence*)(*alternation)[i];
@@ -467,17 +597,22 @@ int Optimizer::repeated_sequence() {
                     "Found identical sequences '%s' in single alternation, erasing second occurence",
                     eliminate.c_str());
                 alternation->erase(i);
-                alternation->update_parents();
-                return 1;
+                optimized++;
+                return true;
             }
         }
-    }
-    return 0;
+        return false;
+    });
 }
 
 int Optimizer::same_rules() {
-    std::vector<Rule*> rules = g.find_children<Rule>();
+    worklist[O_SAME_RULES].clear();
+    scans += rule_count;
+    std::vector<Rule*> rules = g.get_rules();
+    // every rule is scanned as a whole, so all its nodes count as visited, like in the rule-local optimizations
+    visited += profiling ? count_nodes(rules) : 0;
     std::map<size_t, Rule*> hashes;
+    int eliminated = 0;
     for (Rule* rule: rules) {
         size_t hash = rule->hash();
         if (hashes.find(hash) == hashes.end()) {
@@ -496,19 +631,20 @@ int Optimizer::same_rules() {
             log(1, "Found identical rules, replacing %s by %s", eliminate.c_str(), keep.c_str());
             log(4, "  Keep:      %s", rule->to_string().c_str());
             log(4, "  Eliminate: %s", hashes[hash]->to_string().c_str());
-            std::vector<Reference*> refs =
-                g.find_children<Reference>([eliminate](const Reference& ref) { return ref.get_name() == eliminate; });
+            std::vector<Reference*> refs = g.get_references(eliminate);
             for (Reference* ref: refs) {
                 Rule* parent = ref->get_ancestor<Rule>();
                 log(2, "  Replacing reference to %s in rule %s", eliminate.c_str(), parent->get_name().c_str());
                 ref->set_name(keep);
+                touch(*parent);
             }
+            requeue(keep);
+            forget(*rule);
             g.erase(rule);
-            g.update_parents();
-            return refs.size();
+            eliminated++;
         }
     }
-    return 0;
+    return eliminated;
 }
 
 static double calculate_score(int term_count, int ref_count) {
@@ -522,26 +658,31 @@ static double calculate_score(int term_count, int ref_count) {
 }
 
 int Optimizer::inline_rules() {
-    double best_score = 0;
-    int candidate = -1;
-    double min_score = Config::get<double>("inline-limit");
+    worklist[O_INLINE].clear();
+    scans += rule_count;
+    double min_score = Config::settings().inline_limit;
+
+    struct Candidate {
+        Rule* rule;
+        double score;
+        std::set<std::string> users; // names of the rules referencing this one
+    };
+    std::vector<Candidate> candidates;
 
-    std::vector<Rule*> rules = g.find_children<Rule>();
+    std::vector<Rule*> rules = g.get_rules();
+    // every rule is scanned as a whole, so all its nodes count as visited, like in the rule-local optimizations
+    visited += profiling ? count_nodes(rules) : 0;
     // intentionally skipping the first rule, because it is the main one, which can't be inlined anyway
     for (int i = rules.size() - 1; i > 0; i--) {
         Rule& rule = *rules[i];
 
         // check for direct recursion
-        bool is_recursive = !rule.find_children<Reference>(
-                                     [rule](const Reference& ref) -> bool { return ref.references(&rule); }
-        ).empty();
-        if (is_recursive) {
+        if (g.is_recursive(rule)) {
             log(2, "Not inlining %s: rule is recursive", rule.c_str());
             continue;
         }
 
-        std::vector<Reference*> refs =
-            g.find_children<Reference>([rule](const Reference& ref) -> bool { return ref.references(&rule); });
+        std::vector<Reference*> refs = g.get_references(rule.get_name());
 
         if (std::any_of(refs.begin(), refs.end(), [](Reference* r) { return r->has_variable(); })) {
             log(2, "Not inlining %s: rule is used with variables", rule.c_str());
@@ -549,26 +690,21 @@ int Optimizer::inline_rules() {
         }
 
         bool contains_full_rule_ref =
-            !rule.find_children<Action>(
-                     [rule](const Action& action) -> bool { return action.contains_capture(0); }
-            ).empty();
+            find_first<Action>(rule, [](const Action& action) { return action.contains_capture(0); });
         if (contains_full_rule_ref) {
             log(2, "Not inlining %s: rule contains action with '$0'", rule.c_str());
             continue;
         }
 
         bool err_contains_full_rule_ref =
-            !rule.find_children<Term>(
-                     [rule](const Term& term) -> bool { return term.error_action_contains_capture(0); }
-            ).empty();
+            find_first<Term>(rule, [](const Term& term) { return term.error_action_contains_capture(0); });
         if (err_contains_full_rule_ref) {
             log(2, "Not inlining %s: rule contains error action with '$0'", rule.c_str());
             continue;
         }
 
-        bool has_captures = rule.find_children<Action>(
-                                    [](const Action& action) -> bool { return action.contains_any_capture(); }
-        ).size();
+        bool has_captures =
+            find_first<Action>(rule, [](const Action& action) { return action.contains_any_capture(); });
         if (std::any_of(refs.begin(), refs.end(), [has_captures](Reference* ref) {
                 return has_captures
                     && ref->find_ancestors<Term>([](const Term& term) -> bool { return term.is_greedy(); }).size();
@@ -580,109 +716,143 @@ int Optimizer::inline_rules() {
         double score = calculate_score(rule.count_terms() + rule.count_cc_tokens(), refs.size());
         log(4, "Score for %s: %f", rule.c_str(), score);
 
-        if (score > best_score) {
-            best_score = score;
-            candidate = i;
+        if (score >= min_score) {
+            Candidate c = {&rule, score, {}};
+            for (Reference* ref: refs) {
+                c.users.insert(ref->get_ancestor<Rule>()->get_name());
+            }
+            candidates.push_back(c);
         }
     }
-    if (candidate >= 0 && best_score >= min_score) {
-        Rule& rule = *rules[candidate];
-        std::vector<Reference*> refs =
-            g.find_children<Reference>([rule](const Reference& ref) -> bool { return ref.references(&rule); });
-
-        int src_captures = rule.find_children<Capture>().size();
-
-        log(1, "Inlining rule %s (score %f)", rule.c_str(), best_score);
-        for (int j = 0; j < refs.size(); j++) {
-            Term* dest = refs[j]->get_parent<Term>();
-            Group group = rule.convert_to_group();
-            log(2, "  Inlining %s into %s", STR(group), STR(*dest));
-            dest->set_content(group);
-            dest->update_parents();
-            // fix capture references in expands and actions
-            if (src_captures) {
-                Rule* dest_rule = dest->get_ancestor<Rule>();
-                int dest_captures = dest_rule->find_children<Capture>().size();
-                if (dest_captures) {
-                    // Algorithm:
-                    //   shift = how many captures is before the insertion point
-                    //   src_captures = how many captures is in the inserted group
-                    //  - first iterate over rule,
-                    //     - count captures before group (N)
-                    //     - skip the inserted group
-                    //     - increment expands, actions and predicates after the group by M
-                    //   - then iterate over the group only
-                    //     - increase expands, actions and predicates by before number found in first iteration
-                    // example: input:   <1> <2> (<1> <2> <3>) <3> <4>
-                    //          shift:            +2  +2  +2   +3  +3
-                    //          output:  <1> <2> (<3> <4> <5>) <6> <7>
-                    dest_rule->update_captures();
-                    bool after = false;
-                    int shift = 0;
-                    dest_rule->map([&](Node& node) mutable {
-                        if (node.is_descendant_of(dest)) {
-                            after = true;
-                            return false;
+
+    // Best scores first, candidates with equal score keep the order in which they were found.
+    std::stable_sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+        return a.score > b.score;
+    });
+
+    // Inlining a rule changes the rules that reference it and adds references to the rules it references,
+    // which invalidates their checks and scores computed above. So in one sweep we only inline rules that
+    // neither reference nor are referenced by any candidate with a better score. The others are left for
+    // the next pass, when their scores are computed again. The best candidate is the same as when inlining one
+    // rule per pass. However, rule-local optimizations apply all their rewrites in one pass, which can raise
+    // scores of several rules at once, and ties are then decided by the scan order (see c.peg in tests).
+    std::vector<Candidate*> selected;
+    std::set<std::string> better;
+    std::set<std::string> better_users;
+    for (Candidate& c: candidates) {
+        bool independent = !better_users.count(c.rule->get_name())
+                        && std::none_of(c.users.begin(), c.users.end(), [&better](const std::string& user) {
+                               return better.count(user);
+                           });
+        if (independent) {
+            selected.push_back(&c);
+        } else {
+            log(2, "Not inlining %s in this pass: it is related to a rule with better score", c.rule->c_str());
+            // scored again in the next pass, even if none of the rules it is related to gets modified
+            requeue(c.rule->get_name());
+        }
+        better.insert(c.rule->get_name());
+        better_users.insert(c.users.begin(), c.users.end());
+    }
+    for (Candidate* c: selected) {
+        inline_rule(*c->rule, c->score);
+    }
+    return selected.size();
+}
+
+void Optimizer::inline_rule(Rule& rule, double score) {
+    std::vector<Reference*> refs = g.get_references(rule.get_name());
+
+    int src_captures = rule.find_children<Capture>().size();
+
+    log(1, "Inlining rule %s (score %f)", rule.c_str(), score);
+    for (int j = 0; j < refs.size(); j++) {
+        Term* dest = refs[j]->get_parent<Term>();
+        Group group = rule.convert_to_group();
+        log(2, "  Inlining %s into %s", STR(group), STR(*dest));
+        dest->set_content(group);
+        // fix capture references in expands and actions
+        if (src_captures) {
+            Rule* dest_rule = dest->get_ancestor<Rule>();
+            int dest_captures = dest_rule->find_children<Capture>().size();
+            if (dest_captures) {
+                // Algorithm:
+                //   shift = how many captures is before the insertion point
+                //   src_captures = how many captures is in the inserted group
+                //  - first iterate over rule,
+                //     - count captures before group (N)
+                //     - skip the inserted group
+                //     - increment expands, actions and predicates after the group by M
+                //   - then iterate over the group only
+                //     - increase expands, actions and predicates by before number found in first iteration
+                // example: input:   <1> <2> (<1> <2> <3>) <3> <4>
+                //          shift:            +2  +2  +2   +3  +3
+                //          output:  <1> <2> (<3> <4> <5>) <6> <7>
+                dest_rule->update_captures();
+                bool after = false;
+                int shift = 0;
+                walk(*dest_rule, [&](Node& node) {
+                    if (node.is_descendant_of(dest)) {
+                        after = true;
+                        return false;
+                    }
+                    if (!after && node.is<Capture>()) {
+                        shift++;
+                        return false;
+                    }
+                    if (after && node.is<Expand>()) {
+                        std::string prev = node.to_string();
+                        Expand* e = node.as<Expand>();
+                        e->shift(src_captures);
+                        log(2, "  Update expand: %s -> %s", prev.c_str(), STR(node));
+                    } else if (after && node.is<Predicate>()) {
+                        std::string prev = node.to_string();
+                        Predicate* p = node.as<Predicate>();
+                        for (int k = dest_captures; k >= 1; k--) {
+                            p->renumber_capture(k, k + src_captures);
                         }
-                        if (!after && node.is<Capture>()) {
-                            shift++;
-                            return false;
+                        log(2, "  Update predicate: %s -> %s", prev.c_str(), STR(node));
+                    } else if (after && node.is<Action>()) {
+                        std::string prev = node.to_string();
+                        Action* a = node.as<Action>();
+                        for (int k = dest_captures; k >= 1; k--) {
+                            a->renumber_capture(k, k + src_captures);
                         }
-                        if (after && node.is<Expand>()) {
-                            std::string prev = node.to_string();
-                            Expand* e = node.as<Expand>();
-                            e->shift(src_captures);
-                            log(2, "  Update expand: %s -> %s", prev.c_str(), STR(node));
-                        } else if (after && node.is<Predicate>()) {
-                            std::string prev = node.to_string();
-                            Predicate* p = node.as<Predicate>();
-                            for (int k = dest_captures; k >= 1; k--) {
-                                p->renumber_capture(k, k + src_captures);
-                            }
-                            log(2, "  Update predicate: %s -> %s", prev.c_str(), STR(node));
-                        } else if (after && node.is<Action>()) {
-                            std::string prev = node.to_string();
-                            Action* a = node.as<Action>();
-                            for (int k = dest_captures; k >= 1; k--) {
-                                a->renumber_capture(k, k + src_captures);
-                            }
-                            log(2, "  Update action: %s -> %s", prev.c_str(), STR(node));
+                        log(2, "  Update action: %s -> %s", prev.c_str(), STR(node));
+                    }
+                    return false;
+                });
+                walk(dest->get<Group>(), [&](Node& node) {
+                    if (node.is<Expand>()) {
+                        std::string prev = node.to_string();
+                        Expand* e = node.as<Expand>();
+                        e->shift(shift);
+                        log(2, "  Update expand: %s -> %s", prev.c_str(), STR(node));
+                    } else if (node.is<Predicate>()) {
+                        std::string prev = node.to_string();
+                        Predicate* p = node.as<Predicate>();
+                        for (int k = src_captures; k >= 1; k--) {
+                            p->renumber_capture(k, k + shift);
                         }
-                        return false;
-                    });
-                    dest->get<Group>().map([&](Node& node) {
-                        if (node.is<Expand>()) {
-                            std::string prev = node.to_string();
-                            Expand* e = node.as<Expand>();
-                            e->shift(shift);
-                            log(2, "  Update expand: %s -> %s", prev.c_str(), STR(node));
-                        } else if (node.is<Predicate>()) {
-                            std::string prev = node.to_string();
-                            Predicate* p = node.as<Predicate>();
-                            for (int k = src_captures; k >= 1; k--) {
-                                p->renumber_capture(k, k + shift);
-                            }
-                            log(2, "  Update predicate: %s -> %s", prev.c_str(), STR(node));
-                        } else if (node.is<Action>()) {
-                            std::string prev = node.to_string();
-                            Action* a = node.as<Action>();
-                            for (int k = src_captures; k >= 1; k--) {
-                                a->renumber_capture(k, k + shift);
-                            }
-                            log(2, "  Update action: %s -> %s", prev.c_str(), STR(node));
+                        log(2, "  Update predicate: %s -> %s", prev.c_str(), STR(node));
+                    } else if (node.is<Action>()) {
+                        std::string prev = node.to_string();
+                        Action* a = node.as<Action>();
+                        for (int k = src_captures; k >= 1; k--) {
+                            a->renumber_capture(k, k + shift);
                         }
-                        return false;
-                    });
-                }
+                        log(2, "  Update action: %s -> %s", prev.c_str(), STR(node));
+                    }
+                    return false;
+                });
             }
-            debug("  Inlining result: %s", STR(*dest));
         }
-        log(2, "  Removing inlined rule %s", rule.c_str());
-        g.erase(&rule);
-        g.update_parents();
-        return true;
+        debug("  Inlining result: %s", STR(*dest));
+        touch(*dest->get_ancestor<Rule>());
     }
-    return false;
+    log(2, "  Removing inlined rule %s", rule.c_str());
+    forget(rule);
+    g.erase(&rule);
 }
 
 std::chrono::steady_clock::time_point get_deadline(const double& seconds) {
@@ -690,10 +860,11 @@ std::chrono::steady_clock::time_point get_deadline(const double& seconds) {
         + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
 }
 
-Grammar Optimizer::optimize() {
+void Optimizer::optimize() {
+    Arena::Scope scope(g.get_arena());
     int opts = 1;
     int pass = 1;
-    std::string debug_script = Config::get<std::string>("debug-script");
+    std::string debug_script = Config::settings().debug_script;
     debug("Input grammar:\n%s", STR(g));
 
     static Mapping optimization_order[] = {
@@ -714,16 +885,50 @@ Grammar Optimizer::optimize() {
         {O_EMPTY_ACTION, &Optimizer::empty_actions}
     };
 
-    double timeout = Config::get<double>("timeout");
+    // every enabled optimization has to look at every rule at least once
+    for (Mapping optimization: optimization_order) {
+        if (Config::get(optimization.optimization)) {
+            worklist[optimization.optimization] = {};
+        }
+    }
+    for (Rule* rule: g.get_rules()) {
+        touch(*rule);
+        rule_count++;
+    }
+
+    double timeout = Config::settings().timeout;
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
     std::chrono::steady_clock::time_point deadline = get_deadline(timeout);
+    long initial_size = profiling ? count_nodes(g) : 0;
     std::map<Optimization, int> optimization_stats;
     while (opts > 0) {
         log(2, "Optimization pass %d", pass);
+        opts = 0;
         for (Mapping optimization: optimization_order) {
             if (!Config::get(optimization.optimization)) {
                 continue;
             }
+            runs++;
+            Profile& stats = profile[optimization.optimization];
+            if (worklist[optimization.optimization].empty()) {
+                // no rule changed since this optimization last ran without effect
+                skipped_runs++;
+                skipped_scans += rule_count;
+                stats.skipped++;
+                continue;
+            }
+            current = optimization.optimization;
+            long size_before = profiling ? count_nodes(g) : 0;
+            long visited_before = visited;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
             opts = (this->*(optimization.function))();
+            stats.time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            stats.calls++;
+            stats.visited += visited - visited_before;
+            stats.rewrites += opts;
+            if (profiling) {
+                stats.size_delta += count_nodes(g) - size_before;
+            }
             if (opts) {
                 if (optimization_stats.count(optimization.optimization)) {
                     optimization_stats[optimization.optimization] += 1;
@@ -735,6 +940,9 @@ Grammar Optimizer::optimize() {
         }
         if (opts) {
             debug("Grammar after pass %d (%d optimizations):\n%s", pass, opts, STR(g));
+            if (LogLevel::debug) {
+                g.check_hashes();
+            }
         }
         if (opts > 0 && !debug_script.empty()) {
             log(0, "Running debug script %s...", debug_script.c_str());
@@ -770,5 +978,43 @@ Grammar Optimizer::optimize() {
     for (auto& [optimization, count]: optimization_stats) {
         log(2, "  %s: %d", Config::get_opt_name(optimization).c_str(), count);
     }
-    return g;
+    log(2,
+        "Worklist skipped %d of %d optimization runs and %d of %d rule scans",
+        skipped_runs,
+        runs,
+        skipped_scans,
+        scans + skipped_scans);
+
+    if (profiling) {
+        std::vector<std::string> entries;
+        for (Mapping optimization: optimization_order) {
+            Profile& stats = profile[optimization.optimization];
+            entries.push_back(log_format(
+                "        {\"name\": \"%s\", \"enabled\": %s, \"calls\": %d, \"skipped\": %d, \"nodes_visited\": %ld, "
+                "\"rewrites\": %d, \"size_delta\": %ld, \"time\": %.6f}",
+                Config::get_opt_name(optimization.optimization).c_str(),
+                Config::get(optimization.optimization) ? "true" : "false",
+                stats.calls,
+                stats.skipped,
+                stats.visited,
+                stats.rewrites,
+                stats.size_delta,
+                stats.time
+            ));
+        }
+        profile_json = log_format(
+            "{\n    \"input\": %s,\n    \"passes\": %d,\n    \"time\": %.6f,\n    \"size_before\": %ld,\n"
+            "    \"size_after\": %ld,\n    \"optimizations\": [\n%s\n    ]\n}",
+            to_json_string(g.get_input_file()).c_str(),
+            pass - 1,
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count(),
+            initial_size,
+            count_nodes(g),
+            join(entries, ",\n").c_str()
+        );
+    }
+}
+
+const std::string& Optimizer::get_profile() const {
+    return profile_json;
 }
@@ -1,9 +1,14 @@
 #pragma once
 #include "ast/grammar.h"
 #include "config.h"
+#include "thread_pool.h"
+
+#include <map>
+#include <set>
 
 class Optimizer {
     Grammar& g;
+    ThreadPool pool;
 
     typedef int (Optimizer::*OptFuncPtr)();
 
@@ -12,10 +17,42 @@ class Optimizer {
         OptFuncPtr function;
     };
 
-    int apply(const std::function<bool(Node&, int&)>& transform);
+    // Names of rules that each optimization still has to (re)visit. Rules are
+    // added whenever they are modified, so unchanged rules are never rescanned.
+    std::map<Optimization, std::set<std::string>> worklist;
+    Optimization current;
+    int rule_count;
+    int runs;
+    int skipped_runs;
+    int scans;
+    int skipped_scans;
+
+    // data for --profile
+    struct Profile {
+        int calls;
+        int skipped;
+        long visited; // nodes visited, global optimizations count all nodes of the rules they scan
+        int rewrites;
+        long size_delta;
+        double time;
+    };
+    std::map<Optimization, Profile> profile;
+    bool profiling;
+    long visited;
+    std::string profile_json;
+    std::set<std::string> warnings; // already printed by warn_once
+
+    void touch(const Rule& rule);
+    // Removes the rule from all worklists, called when the rule is removed from the grammar.
+    void forget(Rule& rule);
+    // Schedules the global optimizations (inlining and same rules) to check given rule again.
+    void requeue(const std::string& name);
+
+    template<class F> int apply(F&& transform);
 
     int same_rules();
     int inline_rules();
+    void inline_rule(Rule& rule, double score);
     int repeated_sequence();
     int concat_strings();
     int concat_character_classes();
@@ -31,8 +68,13 @@ class Optimizer {
     int empty_actions();
 
 public:
+    // Warnings found while optimizing the rules are collected per rule and printed after the messages of
+    // that rule in the grammar order, each only once per grammar, so the output does not depend on --jobs.
     static void warn_once(const std::string& warning);
 
     Optimizer(Grammar& g);
-    Grammar optimize();
+    void optimize();
+
+    // JSON object describing the last optimize() call, empty if --profile was not given
+    const std::string& get_profile() const;
 };
@@ -1,10 +1,19 @@
+#include <stdio.h>
+
+static FILE *fopen_wrapped(const char *path, const char *mode);
+static int fclose_wrapped(FILE *stream);
+
 #define main disabled_main
 #define fprintf fprintf_wrapped
 #define vfprintf vfprintf_wrapped
+#define fopen fopen_wrapped
+#define fclose fclose_wrapped
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Woverlength-strings"
 #include "packcc.c"
 #pragma GCC diagnostic push
+#undef fclose
+#undef fopen
 #undef vfprintf
 #undef fprintf
 #undef main
@@ -61,13 +70,86 @@ bool_t pcc_match_quoted(void* parser, void* result) {
         update_parser(parser, input_state.bufcur);
         res = TRUE;
     }
-    fclose(input_state.file);
     return res;
 }
 
-bool_t pcc_process(const char *ipath, const char *opath, const string_array_t *dirs, const options_t *opts) {
-    void *const ctx = create_context(ipath, opath, dirs, opts);
-    bool_t result = parse(ctx) && generate(ctx);
+typedef struct pcc_buffer_tag {
+    char *data;
+    size_t len;
+} pcc_buffer_t;
+
+/* Files that PackCC reads from or writes to memory instead of the disk, see pcc_process(). */
+static struct memory_files_tag {
+    const char *input_path;
+    const char *input;
+    size_t input_len;
+    const char *output_paths[2];
+    pcc_buffer_t outputs[2];
+    FILE *streams[2];
+} memory_files;
+
+static FILE *fopen_wrapped(const char *path, const char *mode) {
+    int i;
+    if (memory_files.input && mode[0] == 'r' && strcmp(path, memory_files.input_path) == 0) {
+        if (memory_files.input_len == 0) {
+            return fopen("/dev/null", mode);
+        }
+        return fmemopen((void *)memory_files.input, memory_files.input_len, mode);
+    }
+    for (i = 0; i < 2; i++) {
+        if (mode[0] == 'w' && strcmp(path, memory_files.output_paths[i]) == 0) {
+            free(memory_files.outputs[i].data);
+            memory_files.outputs[i].data = NULL;
+            memory_files.outputs[i].len = 0;
+            memory_files.streams[i] = open_memstream(&memory_files.outputs[i].data, &memory_files.outputs[i].len);
+            return memory_files.streams[i];
+        }
+    }
+    return fopen(path, mode);
+}
+
+static int fclose_wrapped(FILE *stream) {
+    int i;
+    for (i = 0; i < 2; i++) {
+        if (stream == memory_files.streams[i]) {
+            memory_files.streams[i] = NULL;
+        }
+    }
+    return fclose(stream);
+}
+
+bool_t pcc_process(
+    const char *ipath, const char *input, size_t input_len, const char *opath, const string_array_t *dirs,
+    const options_t *opts, pcc_buffer_t *source, pcc_buffer_t *header
+) {
+    size_t len = strlen(opath);
+    char *source_path = (char *)malloc(len + 3);
+    char *header_path = (char *)malloc(len + 3);
+    void *ctx;
+    bool_t result;
+    int i;
+    snprintf(source_path, len + 3, "%s.c", opath);
+    snprintf(header_path, len + 3, "%s.h", opath);
+    memset(&memory_files, 0, sizeof(memory_files));
+    memory_files.input_path = ipath;
+    memory_files.input = input;
+    memory_files.input_len = input_len;
+    memory_files.output_paths[0] = source_path;
+    memory_files.output_paths[1] = header_path;
+
+    ctx = create_context(ipath, opath, dirs, opts);
+    result = parse(ctx) && generate(ctx);
     destroy_context(ctx);
+
+    for (i = 0; i < 2; i++) {
+        if (memory_files.streams[i]) {
+            fclose(memory_files.streams[i]);
+        }
+    }
+    *source = memory_files.outputs[0];
+    *header = memory_files.outputs[1];
+    memset(&memory_files, 0, sizeof(memory_files));
+    free(source_path);
+    free(header_path);
     return result;
 }
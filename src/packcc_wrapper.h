@@ -21,7 +21,17 @@ extern "C" {
 
     size_t pcc_utf8_to_utf32(const char* seq, int* out);
 
-    bool_t pcc_process(const char* ipath, const char* opath, const string_array_t* dirs, const options_t* opts);
+    typedef struct pcc_buffer_tag {
+        char* data; // allocated with malloc(), NULL if nothing was written
+        size_t len;
+    } pcc_buffer_t;
+
+    // Generates parser from ipath, or from the input buffer if it is not NULL. Instead of writing
+    // opath.c and opath.h, the generated code is returned in source and header. Not reentrant.
+    bool_t pcc_process(
+        const char* ipath, const char* input, size_t input_len, const char* opath, const string_array_t* dirs,
+        const options_t* opts, pcc_buffer_t* source, pcc_buffer_t* header
+    );
 
     bool_t pcc_match_quoted(void* parser, void* result);
 }
@@ -4,6 +4,8 @@
 #include "packcc_wrapper.h"
 #include "utils.h"
 
+#include <unordered_map>
+
 Parser::State::State(Parser* p): p(p), saved_pos(p->pos) {}
 
 bool Parser::State::rollback() {
@@ -12,7 +14,7 @@ bool Parser::State::rollback() {
             "Rollback %lu-%lu: %s",
             saved_pos,
             p->pos,
-            to_c_string(p->input.substr(saved_pos, p->pos - saved_pos)).c_str()
+            to_c_string(std::string(p->input.substr(saved_pos, p->pos - saved_pos))).c_str()
         );
     }
     p->pos = saved_pos;
@@ -21,23 +23,28 @@ bool Parser::State::rollback() {
 
 bool Parser::State::commit() {
     p->last_match = p->input.substr(saved_pos, p->pos - saved_pos);
-    debug("Matched %lu-%lu: %s", saved_pos, p->pos, to_c_string(p->last_match).c_str());
+    debug("Matched %lu-%lu: %s", saved_pos, p->pos, to_c_string(std::string(p->last_match)).c_str());
     return true;
 }
 
 bool Parser::State::commit(int start, int end) {
     p->last_match = p->input.substr(start, end - start);
-    debug("Matched %lu-%lu: %s", saved_pos, p->pos, to_c_string(p->last_match).c_str());
+    debug("Matched %lu-%lu: %s", saved_pos, p->pos, to_c_string(std::string(p->last_match)).c_str());
     return true;
 }
 
 bool Parser::State::commit(const std::string& result) {
-    p->last_match = result;
-    debug("Matched %lu-%lu: %s", saved_pos, p->pos, to_c_string(p->last_match).c_str());
+    p->buffer = result;
+    p->last_match = p->buffer;
+    debug("Matched %lu-%lu: %s", saved_pos, p->pos, to_c_string(std::string(p->last_match)).c_str());
     return true;
 }
 
-Parser::Parser(std::string input): input(input), pos(0) {}
+Parser::Parser(std::string_view input): input(input), pos(0) {}
+
+char Parser::current() const {
+    return pos < input.size() ? input[pos] : '\0';
+}
 
 Parser::State Parser::save_point() {
     return State(this);
@@ -47,10 +54,18 @@ bool Parser::is_eof() {
     return pos == input.size();
 }
 
+unsigned long Parser::get_pos() const {
+    return pos;
+}
+
+void Parser::skip(unsigned long count) {
+    pos = std::min(pos + count, (unsigned long)input.size());
+}
+
 void Parser::skip_space() {
     int start = pos;
     while (true) {
-        if (isspace(input[pos])) {
+        if (isspace(current())) {
             pos++;
             continue;
         }
@@ -63,16 +78,15 @@ void Parser::skip_space() {
 
 bool Parser::match_any_char() {
     if (!is_eof()) {
-        last_match = std::string(1, input[pos++]);
+        last_match = input.substr(pos++, 1);
         return true;
     }
     return false;
 }
 
 bool Parser::match(char c) {
-    if (input[pos] == c) {
-        pos++;
-        last_match = std::string(1, c);
+    if (!is_eof() && input[pos] == c) {
+        last_match = input.substr(pos++, 1);
         return true;
     }
     return false;
@@ -90,18 +104,27 @@ bool Parser::match(const std::string& str, bool space) {
     return s.rollback();
 }
 
+static const std::regex& compile(const std::string& r) {
+    // the set of patterns is small and fixed, so they are compiled only once per thread
+    thread_local std::unordered_map<std::string, std::regex> cache;
+    std::unordered_map<std::string, std::regex>::iterator it = cache.find(r);
+    if (it == cache.end()) {
+        it = cache.emplace(r, std::regex(r)).first;
+    }
+    return it->second;
+}
+
 bool Parser::match_re(const std::string& r, bool space) {
     State s(this);
     if (space) {
         skip_space();
     }
-    std::smatch m;
-    if (std::regex_search(input.cbegin() + pos, input.cend(), m, std::regex(r))) {
-        if (m.position(0) == 0) {
-            pos += m.length(0);
-            last_re_match = m;
-            return s.commit();
-        }
+    const char* end = input.data() + input.size();
+    // match_continuous anchors the match at current position, so the rest of the input is not searched,
+    // the results are stored directly in last_re_match to reuse its memory
+    if (std::regex_search(input.data() + pos, end, last_re_match, compile(r), std::regex_constants::match_continuous)) {
+        pos += last_re_match.length(0);
+        return s.commit();
     }
     return s.rollback();
 }
@@ -119,19 +142,21 @@ void Parser::skip_rest_of_line(bool continuable) {
 }
 
 bool Parser::match_comment() {
-    //~ printf("DBG: matching comment @%d: %s\n", pos, input.substr(pos).c_str());
-    std::string result;
-    bool matched = false;
-    if (match_re("[ \t]*#([^\\n]*\\n)", false)) {
-        result = last_re_match.str(1);
-        matched = true;
+    // equivalent to matching "[ \t]*#([^\n]*)\n", but this is called before almost every node
+    // and most of the time it fails on the first character, so it is not worth running the regex engine
+    State s(this);
+    while (current() == ' ' || current() == '\t') {
+        pos++;
     }
-    if (!result.empty() && result.back() == '\n') {
-        result.resize(result.size() - 1);
+    size_t end = pos + 1;
+    if (current() != '#' || (end = input.find('\n', end)) == std::string_view::npos) {
+        s.rollback();
+        last_match = std::string_view();
+        return false;
     }
-    last_match = result;
-    //~ printf("DBG: result: '%s' matched: %d\n", result.c_str(), matched);
-    return matched;
+    unsigned long start = pos + 1;
+    pos = end + 1;
+    return s.commit(start, end);
 }
 
 bool Parser::match_block_comment(bool space) {
@@ -204,12 +229,36 @@ bool Parser::match_code() {
     return s.commit(start, pos - 1);
 }
 
+static bool is_identifier_start(char c) {
+    return c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+static bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
 bool Parser::match_number() {
-    return match_re("[0-9]+");
+    State s(this);
+    skip_space();
+    if (!is_digit(current())) {
+        return s.rollback();
+    }
+    while (is_digit(current())) {
+        pos++;
+    }
+    return s.commit();
 }
 
 bool Parser::match_identifier() {
-    return match_re("[_a-zA-Z][_a-zA-Z0-9]*");
+    State s(this);
+    skip_space();
+    if (!is_identifier_start(current())) {
+        return s.rollback();
+    }
+    while (is_identifier_start(current()) || is_digit(current())) {
+        pos++;
+    }
+    return s.commit();
 }
 
 bool Parser::peek(const char c) {
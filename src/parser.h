@@ -1,14 +1,20 @@
 #pragma once
 #include <regex>
 #include <string>
+#include <string_view>
 
 extern "C" {
 #include "capi.h"
 }
 
+// Recursive descent helper working directly on the input text, which must outlive the parser.
+// Matched text is exposed as a view into the input, so nothing is copied unless the caller keeps it.
 class Parser {
-    std::string input;
+    std::string_view input;
     unsigned long pos;
+    std::string buffer; // storage for last_match, when it is not a part of the input
+
+    char current() const;
 
 public:
     friend void convert_parser(void* parser, char** input, size_t* len, unsigned long* pos);
@@ -25,14 +31,17 @@ public:
         bool commit(const std::string& result);
     };
 
-    std::smatch last_re_match;
-    std::string last_match;
+    std::cmatch last_re_match;
+    std::string_view last_match;
 
-    Parser(std::string input);
+    Parser(std::string_view input);
+    Parser(std::string&& input) = delete;
 
     State save_point();
 
     bool is_eof();
+    unsigned long get_pos() const;
+    void skip(unsigned long count);
     void skip_space();
     void skip_rest_of_line(bool continuable);
 
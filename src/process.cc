@@ -0,0 +1,241 @@
+#include "process.h"
+
+#include "ast/grammar.h"
+#include "cache.h"
+#include "log.h"
+#include "optimizer.h"
+#include "parser.h"
+#include "thread_pool.h"
+#include "utils.h"
+#include "version.h"
+
+#include <algorithm>
+#include <optional>
+
+static Grammar parse(const std::string& input, std::string_view content, const Checker& checker) {
+    log(1, "Validating input grammar ...");
+    checker.validate(input, content);
+
+    log(1, "Parsing grammar ...");
+    Parser peg(content);
+    Grammar g(peg, input);
+    if (!g) {
+        error(PARSING_ERROR, "Failed to parse grammar!");
+    }
+    return g;
+}
+
+static void process_with_packcc(const Checker& checker, const std::string& grammar, const std::string& output) {
+    if (output.empty()) {
+        error(INVALID_ARG, "Option -p/--packcc requires output to file, use -o/--output!");
+    }
+    log(1, "Processing with PackCC ...");
+    if (!checker.packcc(grammar, output)) {
+        throw 10;
+    }
+    log(1, "Parser was generated in %s.{h,c}", output.c_str());
+};
+
+static std::string add_header(const std::string& input, const std::string& result) {
+    if (Config::get(HM_ALWAYS) || (Config::get(HM_AUTO) && Config::get(O_ALL))) {
+        return "# Generated by pegof " + pegof_version + " from " + input + "\n# Do not edit manually\n\n" + result;
+    }
+    return result;
+}
+
+// Formatting without optimizations does not need the whole AST, so the rules that did not change since
+// the previous run can be taken from the cache. The whole grammar is still validated as usual.
+static std::string format_incremental(
+    const std::string& input, std::string_view content, const Checker& checker, FormatCache& cache
+) {
+    log(1, "Validating input grammar ...");
+    checker.validate(input, content);
+
+    log(1, "Formatting grammar ...");
+    std::string result = Grammar::format(content, input, cache);
+
+    log(1, "Validating formatted grammar ...");
+    checker.validate_string("formatted.peg", result);
+    cache.save();
+    return result;
+}
+
+std::string transform(
+    const Config::OutputType& output_type,
+    const std::string& input,
+    std::string_view content,
+    const Checker& checker,
+    std::string& profile
+) {
+    if (output_type == Config::OT_FORMAT && !Config::get(O_ALL) && Config::settings().benchmark.empty()) {
+        FormatCache cache(Config::settings().cache, (long)Config::settings().cache_size * 1024 * 1024, input);
+        if (cache.enabled()) {
+            return add_header(input, format_incremental(input, content, checker, cache));
+        }
+    }
+
+    Grammar g = parse(input, content, checker);
+    g.update_parents();
+    Stats in_stats = checker.stats(g);
+
+    if (Config::get(O_ALL)) {
+        log(1, "Optimizing grammar ...");
+        Optimizer opt(g);
+        opt.optimize();
+        profile = opt.get_profile();
+    }
+    log(2,
+        "Allocated %ld AST nodes (%ld of them reused freed memory) in %ld memory blocks",
+        g.get_arena()->get_allocations(),
+        g.get_arena()->get_reused(),
+        g.get_arena()->get_blocks());
+
+    std::string result;
+    if (output_type != Config::OT_AST) {
+        log(1, "Validating formatted grammar ...");
+        result = g.to_string();
+        checker.validate_string("formatted.peg", result);
+    }
+
+    if (in_stats && Config::get(O_ALL) && (Config::verbose(1) || !Config::settings().benchmark.empty())) {
+        log(1, "Computing stats ...");
+        Stats out_stats = checker.stats(g);
+        log(0, "%s", out_stats.compare(in_stats).c_str());
+    }
+
+    switch (output_type) {
+    case Config::OT_FORMAT: return add_header(input, result);
+    case Config::OT_AST: return g.dump();
+    case Config::OT_GRAPH: return g.dump_graph(input + (Config::get(O_ALL) ? " (optimized)" : ""));
+    case Config::OT_PACKCC: return result;
+    case Config::OT_UNSET: break;
+    }
+    error(INTERNAL_ERROR, "output type not set!");
+}
+
+void process(
+    const Config::OutputType& output_type,
+    const std::string& input,
+    const std::string& output,
+    const Checker& checker,
+    std::string& profile
+) {
+    log(1,
+        "Processing file %s, storing output to %s ...",
+        input.empty() ? "stdin" : input.c_str(),
+        output.empty() ? "stdout" : output.c_str());
+
+    if (output_type == Config::OT_PACKCC && !Config::get(O_ALL)) {
+        // Fast path if we're called just to produce code without any optimizations - no need to parse the grammar
+        process_with_packcc(checker, read_file(input), output);
+        return;
+    }
+
+    FileContent content(input);
+    std::string result = transform(output_type, input, content.view(), checker, profile);
+
+    switch (output_type) {
+    case Config::OT_FORMAT:
+        log(1, "Writing formatted output ...");
+        write_file(output, result);
+        break;
+    case Config::OT_AST:
+        log(1, "Writing AST ...");
+        write_file(output, result);
+        break;
+    case Config::OT_GRAPH:
+        log(1, "Writing graph ...");
+        write_file(output, result);
+        break;
+    case Config::OT_PACKCC: process_with_packcc(checker, result, output); break;
+    case Config::OT_UNSET: error(INTERNAL_ERROR, "output type not set!");
+    }
+}
+
+int process_request(
+    Config::OutputType output_type,
+    const std::string& optimizations,
+    const std::string& input,
+    std::string_view content,
+    std::string& output,
+    std::string& messages
+) {
+    LogCapture capture(messages);
+    try {
+        Config::set_request(output_type, optimizations);
+        Checker checker;
+        checker.set_input_file(input);
+        std::string profile;
+        output = transform(output_type, input, content, checker, profile);
+        return 0;
+    } catch (int e) {
+        return e;
+    } catch (const std::exception& e) {
+        log(0, "Error: %s", e.what());
+        return INTERNAL_ERROR;
+    }
+}
+
+int process_inputs(
+    const Config& conf,
+    const std::vector<int>& selected,
+    std::vector<std::string>& profiles,
+    std::vector<std::optional<std::set<std::string>>>* imports
+) {
+    // Multiple inputs are processed in parallel, each with its own checker and temporary directory. Messages
+    // and standard output are collected per input and printed in the same order as if processed serially.
+    // All inputs are processed even if some of them fail, with any number of jobs, and all their messages are
+    // printed. Exit code is determined by the first failed input.
+    int count = selected.size();
+    std::vector<std::string> logs(count);
+    std::vector<std::string> outputs(count);
+    std::vector<int> results(count, 0);
+    ThreadPool pool(count > 1 ? Config::settings().jobs : 1);
+    bool parallel = pool.size() > 1;
+    try {
+        pool.run(count, [&](int n) {
+            int i = selected[n];
+            std::optional<LogCapture> log_capture;
+            std::optional<OutputCapture> output_capture;
+            std::optional<TempDir::Scope> temp_dir;
+            std::optional<ImportCapture> import_capture;
+            if (imports) {
+                (*imports)[i].reset();
+                import_capture.emplace((*imports)[i]);
+            }
+            if (parallel) {
+                log_capture.emplace(logs[n]);
+                output_capture.emplace(outputs[n]);
+                temp_dir.emplace("input_" + std::to_string(i));
+            }
+            try {
+                Checker checker;
+                checker.set_input_file(conf.inputs[i]);
+                process(conf.output_type, conf.inputs[i], conf.outputs[i], checker, profiles[i]);
+            } catch (int e) {
+                results[n] = e;
+            }
+        });
+    } catch (int e) {
+        return e;
+    }
+    int result = 0;
+    for (int n = 0; n < count; n++) {
+        LogCapture::replay(logs[n]);
+        write_file("", outputs[n]);
+        if (!result) {
+            result = results[n];
+        }
+    }
+    return result;
+}
+
+void write_profile(std::vector<std::string> profiles) {
+    const std::string profile = Config::settings().profile;
+    if (profile.empty()) {
+        return;
+    }
+    log(1, "Writing optimization profile to %s ...", profile.c_str());
+    profiles.erase(std::remove(profiles.begin(), profiles.end(), std::string()), profiles.end());
+    write_file(profile, "[\n" + join(profiles, ",\n") + "\n]\n");
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "checker.h"
+#include "config.h"
+
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Validates, parses and (depending on configuration) optimizes the grammar and returns text of the requested output.
+// For OT_PACKCC, the formatted grammar is returned. The input path is only used in messages and to find imports.
+std::string transform(
+    const Config::OutputType& output_type,
+    const std::string& input,
+    std::string_view content,
+    const Checker& checker,
+    std::string& profile
+);
+
+// Processes single input file and writes the result to output (empty path means stdin/stdout).
+void process(
+    const Config::OutputType& output_type,
+    const std::string& input,
+    const std::string& output,
+    const Checker& checker,
+    std::string& profile
+);
+
+// Processes grammar given in memory with given output type and optimizations, used by the server and the library.
+// Errors are not thrown, the exit code is returned instead. All messages are collected in the messages buffer.
+int process_request(
+    Config::OutputType output_type,
+    const std::string& optimizations,
+    const std::string& input,
+    std::string_view content,
+    std::string& output,
+    std::string& messages
+);
+
+// Processes inputs with given indices (to conf.inputs), in parallel if allowed by --jobs. Profiles are stored
+// at the same index as the input, and so are the imported files if imports is given (see ImportCapture).
+// Returns exit code of the first failed input, or 0 if all succeeded.
+int process_inputs(
+    const Config& conf,
+    const std::vector<int>& selected,
+    std::vector<std::string>& profiles,
+    std::vector<std::optional<std::set<std::string>>>* imports = nullptr
+);
+
+// Writes optimization profiles collected from all inputs, if requested by --profile.
+void write_profile(std::vector<std::string> profiles);
@@ -0,0 +1,133 @@
+#include "server.h"
+
+#include "config.h"
+#include "json.h"
+#include "log.h"
+#include "process.h"
+
+#include <chrono>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Each request is single JSON object on one line, e.g.:
+//   {"id": 1, "action": "optimize", "grammar": "...", "path": "dir/grammar.peg", "optimize": "inline,repeats"}
+// Only "grammar" is required. The response is also one line, with the same id, exit status, the output text,
+// all the messages that would be printed to stderr and time spent processing the request in milliseconds.
+static std::string handle_request(const std::string& line, bool& shutdown) {
+    auto start = std::chrono::steady_clock::now();
+    std::string id = "null";
+    std::string output;
+    std::string messages;
+    int status = 0;
+    try {
+        LogCapture capture(messages);
+        JsonObject request = parse_json_object(line);
+        if (request.count("id")) {
+            id = request["id"].raw;
+        }
+        std::string action = request.count("action") ? request["action"].string : "format";
+        Config::OutputType output_type = Config::OT_FORMAT;
+        std::string optimizations;
+        if (action == "optimize") {
+            optimizations = "all";
+        } else if (action == "ast") {
+            output_type = Config::OT_AST;
+        } else if (action == "graph") {
+            output_type = Config::OT_GRAPH;
+        } else if (action == "shutdown") {
+            shutdown = true;
+        } else if (action != "format") {
+            error(INVALID_ARG, "Unknown action '%s'", action.c_str());
+        }
+        if (!shutdown) {
+            if (!request.count("grammar") || request["grammar"].type != JsonValue::JT_STRING) {
+                error(INVALID_ARG, "Request must contain the grammar as a string");
+            }
+            if (request.count("optimize")) {
+                optimizations = request["optimize"].string;
+            }
+            std::string path = request.count("path") ? request["path"].string : "";
+            status = process_request(output_type, optimizations, path, request["grammar"].string, output, messages);
+        }
+    } catch (int e) {
+        status = e;
+    }
+    double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    log(1, "Request %s processed in %.3f ms with status %d", id.c_str(), time, status);
+    return "{\"id\":" + id + ",\"status\":" + std::to_string(status) + ",\"output\":" + to_json_string(output) +
+           ",\"log\":" + to_json_string(messages) + ",\"time\":" + log_format("%.3f", time) + "}\n";
+}
+
+// Serves requests from single stream until it is closed, returns false if shutdown was requested.
+static bool serve_connection(int in, int out, bool is_socket) {
+    std::string buffer;
+    char chunk[65536];
+    bool shutdown = false;
+    while (!shutdown) {
+        size_t eol = buffer.find('\n');
+        if (eol == std::string::npos) {
+            ssize_t size = read(in, chunk, sizeof(chunk));
+            if (size <= 0) {
+                break;
+            }
+            buffer.append(chunk, size);
+            continue;
+        }
+        std::string line = buffer.substr(0, eol);
+        buffer.erase(0, eol + 1);
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+        std::string response = handle_request(line, shutdown);
+        // responses to closed sockets must not kill the server with SIGPIPE
+        for (size_t written = 0; written < response.size();) {
+            ssize_t size = is_socket ? send(out, response.data() + written, response.size() - written, MSG_NOSIGNAL)
+                                     : write(out, response.data() + written, response.size() - written);
+            if (size <= 0) {
+                return !shutdown;
+            }
+            written += size;
+        }
+    }
+    return !shutdown;
+}
+
+int serve(const std::string& socket_path) {
+    if (socket_path.empty()) {
+        log(1, "Serving requests from standard input ...");
+        serve_connection(STDIN_FILENO, STDOUT_FILENO, false);
+        return 0;
+    }
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        error(INVALID_ARG, "Socket path '%s' is too long", socket_path.c_str());
+    }
+    strcpy(address.sun_path, socket_path.c_str());
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socket_path.c_str());
+    if (fd < 0 || bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(fd, 16) != 0) {
+        error(IO_ERROR, "Failed to listen on socket '%s': %s", socket_path.c_str(), strerror(errno));
+    }
+    log(1, "Serving requests on socket %s ...", socket_path.c_str());
+    // connections are served one at a time, clients are expected to be short-lived (editors, hooks)
+    bool running = true;
+    while (running) {
+        int connection = accept(fd, nullptr, nullptr);
+        if (connection < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            error(IO_ERROR, "Failed to accept connection on socket '%s': %s", socket_path.c_str(), strerror(errno));
+        }
+        running = serve_connection(connection, connection, true);
+        close(connection);
+    }
+    close(fd);
+    unlink(socket_path.c_str());
+    return 0;
+}
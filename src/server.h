@@ -0,0 +1,6 @@
+#pragma once
+#include <string>
+
+// Keeps processing requests until the input is closed or shutdown is requested. Requests are read from standard
+// input, or from connections to given Unix socket, and the responses are written back the same way.
+int serve(const std::string& socket);
@@ -0,0 +1,84 @@
+#include "thread_pool.h"
+
+thread_local bool ThreadPool::in_task = false;
+
+ThreadPool::ThreadPool(int threads):
+    task(nullptr), count(0), next(0), running(0), batch(0), failure(nullptr), stopping(false) {
+    for (int i = 1; i < threads && !in_task; i++) {
+        workers.emplace_back(&ThreadPool::worker, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& t: workers) {
+        t.join();
+    }
+}
+
+int ThreadPool::size() const {
+    return workers.size() + 1;
+}
+
+void ThreadPool::work_on_batch(std::unique_lock<std::mutex>& guard) {
+    running++;
+    while (next < count) {
+        int i = next++;
+        guard.unlock();
+        in_task = true;
+        try {
+            (*task)(i);
+        } catch (...) {
+            guard.lock();
+            if (!failure) {
+                failure = std::current_exception();
+            }
+            guard.unlock();
+        }
+        in_task = false;
+        guard.lock();
+    }
+    running--;
+    if (running == 0) {
+        idle.notify_all();
+    }
+}
+
+void ThreadPool::worker() {
+    std::unique_lock<std::mutex> guard(lock);
+    long done = 0;
+    while (true) {
+        wake.wait(guard, [this, done] { return stopping || batch != done; });
+        if (stopping) {
+            return;
+        }
+        done = batch;
+        work_on_batch(guard);
+    }
+}
+
+void ThreadPool::run(int count, const std::function<void(int)>& task) {
+    if (workers.empty()) {
+        for (int i = 0; i < count; i++) {
+            task(i);
+        }
+        return;
+    }
+    std::unique_lock<std::mutex> guard(lock);
+    this->task = &task;
+    this->count = count;
+    next = 0;
+    failure = nullptr;
+    batch++;
+    wake.notify_all();
+    work_on_batch(guard);
+    idle.wait(guard, [this] { return next >= this->count && running == 0; });
+    this->task = nullptr;
+    if (failure) {
+        std::rethrow_exception(failure);
+    }
+}
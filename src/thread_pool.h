@@ -0,0 +1,44 @@
+#pragma once
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for running batches of independent tasks. The calling thread
+// takes part in the work too, so a pool of size 1 has no extra threads and runs everything
+// serially, in order. Pools created inside a task of another parallel pool are always serial,
+// so that nested parallelism does not multiply the number of threads.
+class ThreadPool {
+    std::vector<std::thread> workers;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable idle;
+
+    // current batch
+    const std::function<void(int)>* task;
+    int count;
+    int next;
+    int running;
+    long batch;
+    std::exception_ptr failure;
+    bool stopping;
+
+    static thread_local bool in_task;
+
+    void work_on_batch(std::unique_lock<std::mutex>& guard);
+    void worker();
+
+public:
+    ThreadPool(int threads);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool& other) = delete;
+    ThreadPool& operator=(const ThreadPool& other) = delete;
+
+    int size() const;
+
+    // Calls task(i) for each i from 0 to count - 1 and waits until all of them finish.
+    // If some of the tasks throw, one of the exceptions is rethrown.
+    void run(int count, const std::function<void(int)>& task);
+};
@@ -3,6 +3,7 @@
 #include "log.h"
 #include "packcc_wrapper.h"
 
+#include <cstdint>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
@@ -10,7 +11,10 @@
 #include <random>
 #include <regex>
 #include <sstream>
+#include <fcntl.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #if USE_EXPERIMENTAL_FILESYSTEM
@@ -40,34 +44,98 @@ TempDir::~TempDir() {
     fs::remove_all(path);
 }
 
+thread_local std::string TempDir::subdir;
+
+TempDir::Scope::Scope(const std::string& name): previous(subdir) {
+    subdir = (fs::path(subdir) / name).native();
+    std::error_code ec;
+    fs::create_directories(get(""), ec);
+    if (ec) {
+        error(IO_ERROR, "Failed to create temporary directory '%s'!", get("").c_str());
+    }
+}
+
+TempDir::Scope::~Scope() {
+    subdir = previous;
+}
+
 std::string TempDir::get(const std::string& filename) {
     static TempDir instance;
+    fs::path dir = subdir.empty() ? fs::path(instance.path) : fs::path(instance.path) / subdir;
     if (filename.empty()) {
-        return instance.path;
+        return dir.native();
     } else {
-        return (fs::path(instance.path) / filename).native();
+        return (dir / filename).native();
     }
 }
 
-std::string read_file(const std::string& filename) {
-    std::stringstream buffer;
-    if (filename.empty()) {
-        if (!std::cin) {
-            error(IO_ERROR, "Failed to read file '%s'", filename.c_str());
+static thread_local std::string* output_capture = nullptr;
+
+OutputCapture::OutputCapture(std::string& buffer): previous(output_capture) {
+    output_capture = &buffer;
+}
+
+OutputCapture::~OutputCapture() {
+    output_capture = previous;
+}
+
+bool FileContent::use_mapping = true;
+
+FileContent::FileContent(const std::string& filename): mapping(MAP_FAILED), length(0) {
+    int fd = filename.empty() ? STDIN_FILENO : open(filename.c_str(), O_RDONLY);
+    auto fail = [&filename, fd]() {
+        if (fd >= 0 && fd != STDIN_FILENO) {
+            close(fd);
         }
-        buffer << std::cin.rdbuf();
+        error(IO_ERROR, "Failed to read file '%s'", filename.c_str());
+    };
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || S_ISDIR(st.st_mode)) {
+        fail();
+    }
+    if (use_mapping && S_ISREG(st.st_mode) && st.st_size > 0) {
+        mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    if (mapping != MAP_FAILED) {
+        length = st.st_size;
+        madvise(mapping, length, MADV_SEQUENTIAL);
     } else {
-        std::ifstream input = std::ifstream(filename);
-        if (!input) {
-            error(IO_ERROR, "Failed to read file '%s'", filename.c_str());
+        // not a regular file or it can't be mapped, just read whatever comes
+        char chunk[65536];
+        ssize_t count;
+        while ((count = read(fd, chunk, sizeof(chunk))) > 0) {
+            buffer.append(chunk, count);
+        }
+        if (count < 0) {
+            fail();
         }
-        buffer << input.rdbuf();
     }
-    return buffer.str();
+    if (fd != STDIN_FILENO) {
+        close(fd);
+    }
+}
+
+FileContent::~FileContent() {
+    if (mapping != MAP_FAILED) {
+        munmap(mapping, length);
+    }
+}
+
+std::string_view FileContent::view() const {
+    if (mapping != MAP_FAILED) {
+        return std::string_view((const char*)mapping, length);
+    }
+    return buffer;
+}
+
+std::string read_file(const std::string& filename) {
+    return std::string(FileContent(filename).view());
 }
 
 void write_file(const std::string& filename, const std::string& content) {
-    if (filename.empty()) {
+    if (filename.empty() && output_capture) {
+        *output_capture += content;
+    } else if (filename.empty()) {
         printf("%s", content.c_str());
     } else {
         std::ofstream ofs(filename);
@@ -92,12 +160,84 @@ std::string find_file(const std::string& name, const std::vector<std::string> di
     return "";
 }
 
+std::string canonical_path(const std::string& path) {
+    std::error_code ec;
+    fs::path result = fs::canonical(path, ec);
+    return ec ? path : result.string();
+}
+
 std::string to_hex(int number, int width) {
     std::stringstream stream;
     stream << std::setfill('0') << std::setw(width) << std::hex << number;
     return stream.str();
 }
 
+// Plain SHA-256 (FIPS 180-4), used to build keys that identify grammars across runs.
+std::string sha256(std::string_view data) {
+    static const uint32_t k[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+    };
+    uint32_t h[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    auto rotr = [](uint32_t x, int n) { return (x >> n) | (x << (32 - n)); };
+
+    std::string message(data);
+    uint64_t bits = (uint64_t)data.size() * 8;
+    message += (char)0x80;
+    while (message.size() % 64 != 56) {
+        message += (char)0;
+    }
+    for (int i = 7; i >= 0; i--) {
+        message += (char)(bits >> (i * 8));
+    }
+
+    for (size_t chunk = 0; chunk < message.size(); chunk += 64) {
+        uint32_t w[64];
+        for (int i = 0; i < 16; i++) {
+            const unsigned char* p = (const unsigned char*)message.data() + chunk + i * 4;
+            w[i] = (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | (uint32_t)p[3];
+        }
+        for (int i = 16; i < 64; i++) {
+            uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], x = h[7];
+        for (int i = 0; i < 64; i++) {
+            uint32_t t1 = x + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+            uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            x = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+        h[5] += f;
+        h[6] += g;
+        h[7] += x;
+    }
+
+    std::string result;
+    for (uint32_t word: h) {
+        result += to_hex(word, 8);
+    }
+    return result;
+}
+
 std::string to_c_string(std::string str, EscapeMode mode) {
     unsigned long pos = 0;
     int c = 0;
@@ -137,13 +277,13 @@ std::string to_c_string(std::string str, EscapeMode mode) {
     return result;
 }
 
-std::string trim(const std::string& str, TrimType type, const char* whitespace) {
+std::string trim(std::string_view str, TrimType type, const char* whitespace) {
     size_t start = (type & TRIM_LEFT) ? str.find_first_not_of(whitespace) : 0;
     size_t end = (type & TRIM_RIGHT) ? str.find_last_not_of(whitespace) + 1 : str.size();
-    if (start == std::string::npos) {
+    if (start == std::string_view::npos) {
         start = 0;
     }
-    return std::string(str.c_str() + start, end - start);
+    return std::string(str.substr(start, end - start));
 }
 
 std::vector<std::string> split(const std::string& s, const std::string& delimiter) {
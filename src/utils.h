@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
 
 #define STR(x) (x).to_string().c_str()
@@ -10,14 +11,56 @@ private:
     ~TempDir();
     std::string path;
 
+    static thread_local std::string subdir;
+
 public:
+    // Makes get() return paths in a separate subdirectory in the current thread for the lifetime
+    // of the scope object, so that inputs processed in parallel do not overwrite each other's files.
+    class Scope {
+        std::string previous;
+
+    public:
+        Scope(const std::string& name);
+        ~Scope();
+    };
+
     static std::string get(const std::string& filename);
 };
 
+// Collects everything that write_file() would print to standard output in the current thread.
+class OutputCapture {
+    std::string* previous;
+
+public:
+    OutputCapture(std::string& buffer);
+    ~OutputCapture();
+};
+
+// Read-only content of a file, empty filename means stdin. Regular files are memory mapped,
+// anything else (pipes, terminals, ...) is read into memory.
+class FileContent {
+    std::string buffer;
+    void* mapping;
+    size_t length;
+
+public:
+    // Accessing a mapped file that was truncated by another process raises SIGBUS. Long running modes
+    // (--watch, --serve) read files while editors rewrite them, so they disable the mapping.
+    static bool use_mapping;
+
+    FileContent(const std::string& filename);
+    FileContent(const FileContent& other) = delete;
+    FileContent& operator=(const FileContent& other) = delete;
+    ~FileContent();
+
+    std::string_view view() const;
+};
+
 std::string read_file(const std::string& filename);
 void write_file(const std::string& filename, const std::string& content);
 std::string dirname(const std::string& path);
 std::string find_file(const std::string& name, const std::vector<std::string> dirs);
+std::string canonical_path(const std::string& path);
 
 enum EscapeMode {
     ESCAPE_SINGLE_QUOTES = 1,
@@ -26,11 +69,12 @@ enum EscapeMode {
 };
 
 std::string to_hex(int number, int width);
+std::string sha256(std::string_view data);
 std::string to_c_string(std::string str, EscapeMode mode = ESCAPE_ALL);
 
 enum TrimType { TRIM_LEFT = 1, TRIM_RIGHT = 2, TRIM_BOTH = TRIM_LEFT | TRIM_RIGHT };
 
-std::string trim(const std::string& str, TrimType type = TRIM_BOTH, const char* whitespace = " \t\r\n");
+std::string trim(std::string_view str, TrimType type = TRIM_BOTH, const char* whitespace = " \t\r\n");
 std::vector<std::string> split(const std::string& s, const std::string& delimiter = "\\s*,\\s*");
 std::string join(const std::vector<std::string>& v, const std::string& delimiter = "\n");
 bool contains(std::vector<std::string> values, std::string x);
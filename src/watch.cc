@@ -0,0 +1,156 @@
+#include "watch.h"
+
+#include "ast/grammar.h"
+#include "log.h"
+#include "process.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <numeric>
+#include <optional>
+#include <poll.h>
+#include <set>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+// Reports changes of files using inotify. Directories are watched instead of the files themselves, because
+// many editors save files by writing a new file and renaming it over the original one.
+class Watcher {
+    int fd;
+    std::map<std::string, int> watches; // directory -> watch descriptor
+    std::map<int, std::string> directories;
+
+    // Reads all pending events and adds paths of the changed files to the result.
+    void read_events(std::set<std::string>& changed) {
+        alignas(struct inotify_event) char buffer[65536];
+        ssize_t size = read(fd, buffer, sizeof(buffer));
+        if (size <= 0) {
+            error(IO_ERROR, "Failed to read file system events");
+        }
+        for (char* ptr = buffer; ptr < buffer + size;) {
+            const struct inotify_event* event = (const struct inotify_event*)ptr;
+            auto dir = directories.find(event->wd);
+            if (dir != directories.end() && event->len > 0) {
+                changed.insert(dir->second + "/" + event->name);
+            }
+            ptr += sizeof(struct inotify_event) + event->len;
+        }
+    }
+
+public:
+    Watcher(): fd(inotify_init1(IN_CLOEXEC)) {
+        if (fd < 0) {
+            error(IO_ERROR, "Failed to initialize inotify");
+        }
+    }
+
+    ~Watcher() {
+        close(fd);
+    }
+
+    // Watches directories of given files and stops watching all other directories.
+    void update(const std::set<std::string>& files) {
+        std::set<std::string> needed;
+        for (const std::string& file: files) {
+            needed.insert(dirname(file));
+        }
+        for (auto it = watches.begin(); it != watches.end();) {
+            if (needed.count(it->first)) {
+                ++it;
+                continue;
+            }
+            log(3, "Stopped watching directory %s", it->first.c_str());
+            inotify_rm_watch(fd, it->second);
+            directories.erase(it->second);
+            it = watches.erase(it);
+        }
+        for (const std::string& dir: needed) {
+            if (watches.count(dir)) {
+                continue;
+            }
+            int wd = inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE);
+            if (wd < 0) {
+                warn("Failed to watch directory %s", dir.c_str());
+                continue;
+            }
+            log(3, "Watching directory %s", dir.c_str());
+            watches[dir] = wd;
+            directories[wd] = dir;
+        }
+    }
+
+    // Waits until some files change. Events that come shortly after each other (e.g. when multiple files
+    // are saved at once) are reported together.
+    std::set<std::string> wait() {
+        std::set<std::string> changed;
+        struct pollfd pfd = {fd, POLLIN, 0};
+        for (int timeout = -1; poll(&pfd, 1, timeout) > 0; timeout = 100) {
+            read_events(changed);
+        }
+        return changed;
+    }
+};
+
+// Returns canonical paths of all files that the result of processing given input depends on. Imports found
+// while processing the input are used if there are any, the input is only parsed again if they were not followed.
+static std::set<std::string> dependencies(
+    const std::string& input, const std::optional<std::set<std::string>>& imports
+) {
+    std::set<std::string> result;
+    std::string ignored;
+    if (imports) {
+        result = *imports;
+    } else {
+        try {
+            // missing or broken imports are reported when the input is processed
+            LogCapture capture(ignored);
+            result = Grammar::find_imported_files(input);
+        } catch (int) {
+        }
+    }
+    result.insert(canonical_path(input));
+    return result;
+}
+
+int watch(const Config& conf) {
+    int count = conf.inputs.size();
+    std::vector<std::string> profiles(count);
+    std::vector<std::set<std::string>> depends(count); // kept from the last time each input was processed
+    std::vector<std::optional<std::set<std::string>>> imports(count);
+    std::vector<int> selected(count);
+    std::iota(selected.begin(), selected.end(), 0);
+    Watcher watcher;
+    while (true) {
+        if (process_inputs(conf, selected, profiles, &imports) == 0) {
+            write_profile(profiles);
+        }
+        // results written to standard output must be visible before waiting for the next change
+        fflush(stdout);
+
+        std::set<std::string> watched;
+        for (int i = 0; i < count; i++) {
+            if (std::find(selected.begin(), selected.end(), i) != selected.end()) {
+                depends[i] = dependencies(conf.inputs[i], imports[i]);
+            }
+            watched.insert(depends[i].begin(), depends[i].end());
+        }
+        watcher.update(watched);
+
+        log(1, "Waiting for changes in %ld files ...", (long)watched.size());
+        selected.clear();
+        while (selected.empty()) {
+            std::set<std::string> changed = watcher.wait();
+            for (int i = 0; i < count; i++) {
+                for (const std::string& file: changed) {
+                    if (depends[i].count(file)) {
+                        log(1, "File %s changed, processing %s again ...", file.c_str(), conf.inputs[i].c_str());
+                        selected.push_back(i);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+}
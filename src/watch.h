@@ -0,0 +1,6 @@
+#pragma once
+#include "config.h"
+
+// Processes all inputs and then keeps processing them again whenever they, or any files imported from them,
+// change. Only the inputs affected by the change are processed again. Runs until interrupted.
+int watch(const Config& conf);
@@ -0,0 +1,55 @@
+#!/usr/bin/env bats
+load "$TESTDIR/utils.sh"
+
+# Creates a file of given size in megabytes, with modification time far in the past.
+create_old_file() {
+    head -c "$(($2 * 1024 * 1024))" /dev/zero > "$1"
+    touch -d "2000-01-01" "$1"
+}
+
+@test "cache.d - eviction keeps foreign files" {
+    DIR="cache.d/foreign.tmp"
+    OWN="$DIR/$(printf '0%.0s' {1..64})"
+    mkdir -p "$DIR"
+    create_old_file "$DIR/notes.txt" 2
+    create_old_file "$DIR/notes.txt.tmp" 2
+    create_old_file "$OWN" 2
+    run "$PEGOF" --cache "$DIR" --cache-size 1 cache.d/valid.peg
+    [ "$status" -eq 0 ]
+    [ -e "$DIR/notes.txt" ]
+    [ -e "$DIR/notes.txt.tmp" ]
+    [ ! -e "$OWN" ]
+}
+
+@test "cache.d - cached errors are the same as from PackCC" {
+    DIR="cache.d/errors.tmp"
+    run "$PEGOF" --cache "$DIR" cache.d/invalid.peg
+    [ "$status" -ne 0 ]
+    [[ "$output" == *missing_rule* ]]
+    FIRST_STATUS="$status"
+    FIRST_OUTPUT="$output"
+
+    run "$PEGOF" --cache "$DIR" cache.d/invalid.peg
+    [ "$status" -eq "$FIRST_STATUS" ]
+    [ "$output" == "$FIRST_OUTPUT" ] || diff -u <(echo "$FIRST_OUTPUT") <(echo "$output")
+
+    run "$PEGOF" -v -v -v --cache "$DIR" cache.d/invalid.peg
+    [[ "$output" == *"Validation cache hit"* ]]
+}
+
+@test "cache.d - least recently used entries are evicted over size limit" {
+    DIR="cache.d/limit.tmp"
+    OLDEST="$DIR/$(printf '1%.0s' {1..64})"
+    NEWER="$DIR/$(printf '2%.0s' {1..64})"
+    mkdir -p "$DIR"
+    head -c 819200 /dev/zero > "$OLDEST"
+    head -c 409600 /dev/zero > "$NEWER"
+    touch -d "2000-01-01" "$OLDEST"
+    touch -d "2001-01-01" "$NEWER"
+    run "$PEGOF" --cache "$DIR" --cache-size 1 cache.d/valid.peg
+    [ "$status" -eq 0 ]
+    [ -e "$NEWER" ]
+    [ ! -e "$OLDEST" ]
+    # entries stored by this run are the most recent ones, so they are kept
+    [ "$(ls "$DIR" | grep -cE '^[0-9a-f]{64}$')" -gt 1 ]
+}
@@ -0,0 +1,7 @@
+#!/usr/bin/env bats
+load "$TESTDIR/utils.sh"
+
+@test "libpegof.d - in-process API" {
+    run "$BUILDDIR/libpegof_test"
+    [ "$status" -eq 0 ] || { echo "$output"; false; }
+}
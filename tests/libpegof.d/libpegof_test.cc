@@ -0,0 +1,64 @@
+// Checks the in-process API, the executable is built by the test target and run from libpegof.bats.
+#include "libpegof.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+static void check(bool condition, const char* description, const std::string& log) {
+    if (!condition) {
+        fprintf(stderr, "FAILED: %s\n%s", description, log.c_str());
+        failures++;
+    }
+}
+
+int main() {
+    const std::string grammar = "main <- A B / C\nA <- \"A\"\nB <- \"B\"\nC <- \"C\"\n";
+    std::string output;
+    std::string log;
+
+    int status = pegof_format(grammar, "", output, log);
+    check(status == 0, "format with default options", log);
+    check(output == "main <-\n    A B\n    / C\n\nA <- \"A\"\n\nB <- \"B\"\n\nC <- \"C\"\n", "format output", output);
+
+    log.clear();
+    status = pegof_configure({"--help"}, log);
+    check(status == 1, "--help is rejected", log);
+
+    log.clear();
+    status = pegof_configure({"--version"}, log);
+    check(status == 1, "--version is rejected", log);
+    check(log.find("Pegof version") != std::string::npos, "version is printed to log", log);
+
+    const std::vector<std::vector<std::string>> rejected = {
+        {"--input", "grammar.peg"},
+        {"grammar.peg"},
+        {"--output", "output.peg"},
+        {"--inplace"},
+        {"--serve"},
+        {"--watch", "grammar.peg"},
+    };
+    for (const std::vector<std::string>& options: rejected) {
+        log.clear();
+        status = pegof_configure(options, log);
+        check(status == 1, ("'" + options[0] + "' is rejected").c_str(), log);
+    }
+
+    log.clear();
+    status = pegof_configure({"--quotes", "single"}, log);
+    check(status == 0, "configure quotes", log);
+    output.clear();
+    status = pegof_format(grammar, "", output, log);
+    check(status == 0, "format with single quotes", log);
+    check(output == "main <-\n    A B\n    / C\n\nA <- 'A'\n\nB <- 'B'\n\nC <- 'C'\n", "single quotes", output);
+
+    output.clear();
+    log.clear();
+    status = pegof_format("main <- \"x\" missing_rule\n", "", output, log);
+    check(status != 0, "invalid grammar fails", log);
+    check(log.find("missing_rule") != std::string::npos, "errors are returned in log", log);
+
+    return failures;
+}
@@ -34,6 +34,7 @@ EOF
         echo "    run_test \"$CONF\" \"$(get_inputs "$CONF")\"$INPUT"
         echo "    check_status ${CONF//.conf/}.status"
         [ -e "${CONF//.conf/.out}" ] && echo "    check_stdout \"${CONF//.conf/.out}\""
+        [ -e "${CONF//.conf/.check}" ] && echo "    \"${CONF//.conf/.check}\" <<<\"\$output\""
         for OUTPUT in "${OUTPUTS[@]}"; do
             if [ -e "$OUTPUT.$BASE.expected" ]; then
                 echo "    check_file \"$OUTPUT.$BASE.expected\" \"$OUTPUT.tmp\""
@@ -47,7 +48,7 @@ EOF
 }
 
 clean() {
-    rm -f "$TESTDIR"/*.d/generated.bats "$TESTDIR"/*.d/*.tmp "$TESTDIR"/**/*.processed.{c,h} "$BUILDDIR"/**/*.gcda
+    rm -rf "$TESTDIR"/*.d/generated.bats "$TESTDIR"/*.d/*.tmp "$TESTDIR"/**/*.processed.{c,h} "$BUILDDIR"/**/*.gcda
 }
 
 main() {
@@ -0,0 +1,26 @@
+#!/usr/bin/env bats
+load "$TESTDIR/utils.sh"
+
+# Prints response to the request with given id.
+response() {
+    grep "^{\"id\":$1," <<<"$output"
+}
+
+@test "serve.d - errors of previous requests are not repeated" {
+    run "$PEGOF" --serve < serve.d/errors.in
+    [ "$status" -eq 0 ]
+    [[ "$(response 1)" == *'"status":'[1-9]*missing_first* ]]
+    [[ "$(response 2)" == *'"status":0,'* ]]
+    [[ "$(response 3)" == *'"status":'[1-9]*missing_third* ]]
+    [[ "$(response 3)" != *missing_first* ]]
+}
+
+@test "serve.d - only valid surrogate pairs are accepted" {
+    run "$PEGOF" --serve < serve.d/surrogates.in
+    [ "$status" -eq 0 ]
+    [[ "${lines[0]}" == '{"id":1,"status":0,'* ]]
+    for LINE in "${lines[@]:1}"; do
+        [[ "$LINE" == *'"status":1,'*'invalid surrogate pair'* ]]
+    done
+    [ "${#lines[@]}" -eq 4 ]
+}
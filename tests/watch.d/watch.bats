@@ -0,0 +1,37 @@
+#!/usr/bin/env bats
+load "$TESTDIR/utils.sh"
+
+# Waits up to 10 seconds until given file exists.
+wait_for() {
+    for _ in $(seq 100); do
+        [ -e "$1" ] && return 0
+        sleep 0.1
+    done
+    return 1
+}
+
+setup() {
+    DIR="$(mktemp -d)"
+    cp watch.d/a.peg watch.d/b.peg watch.d/common.peg "$DIR"
+}
+
+teardown() {
+    [ -z "$WATCH_PID" ] || kill "$WATCH_PID"
+    rm -rf "$DIR"
+}
+
+@test "watch.d - only inputs importing the changed file are processed again" {
+    "$PEGOF" --watch -O all -H never -i "$DIR/a.peg" -o "$DIR/a.out" -i "$DIR/b.peg" -o "$DIR/b.out" 2> /dev/null &
+    WATCH_PID=$!
+    wait_for "$DIR/a.out"
+    wait_for "$DIR/b.out"
+    [ "$(cat "$DIR/a.out")" == 'main <- "ac"' ]
+    # the watcher is set up after the first processing, give it a moment
+    sleep 0.5
+    rm "$DIR/a.out" "$DIR/b.out"
+    echo 'common <- "d"' > "$DIR/common.peg"
+    wait_for "$DIR/a.out"
+    [ "$(cat "$DIR/a.out")" == 'main <- "ad"' ]
+    sleep 0.5
+    [ ! -e "$DIR/b.out" ]
+}